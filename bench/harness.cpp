@@ -0,0 +1,63 @@
+#include "harness.hpp"
+
+#include <chrono>
+#include <vector>
+
+namespace bench {
+
+    namespace {
+        struct Case {
+            std::string name;
+            Setup setup;
+        };
+
+        std::vector<Case> &Registry() {
+            static std::vector<Case> cases;
+            return cases;
+        }
+
+        Result Measure(const std::string &name, const Kernel &kernel, double min_time_seconds) {
+            using clock = std::chrono::steady_clock;
+
+            Result result{.name = name};
+            uint64_t evaluations = 0;
+            double elapsed = 0;
+
+            // итерации удваиваются, чтобы замер не тонул в вызовах clock::now(),
+            // хотя бы одна итерация выполняется всегда
+            uint64_t batch = 1;
+            do {
+                auto evaluations_before = *kernel.evaluations;
+                auto start = clock::now();
+                for (uint64_t i = 0; i < batch; ++i) {
+                    kernel.run();
+                }
+                elapsed += std::chrono::duration<double>(clock::now() - start).count();
+
+                evaluations += *kernel.evaluations - evaluations_before;
+                result.iterations += batch;
+                batch *= 2;
+            } while (elapsed < min_time_seconds);
+
+            result.ns_per_iteration = elapsed * 1e9 / result.iterations;
+            result.evaluations_per_second = evaluations / elapsed;
+            return result;
+        }
+    }
+
+    void Register(std::string name, Setup setup) {
+        Registry().push_back(Case{std::move(name), std::move(setup)});
+    }
+
+    std::vector<Result> RunAll(const std::string &filter, double min_time_seconds) {
+        std::vector<Result> results;
+        for (const auto &benchmark: Registry()) {
+            if (benchmark.name.find(filter) == std::string::npos) {
+                continue;
+            }
+            auto kernel = benchmark.setup();
+            results.push_back(Measure(benchmark.name, kernel, min_time_seconds));
+        }
+        return results;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../utils/problem_arguments.hpp"
+
+/// Минимальная замена Google Benchmark без внешних зависимостей.
+///
+/// Бенчмарк регистрируется функцией подготовки: она вызывается один раз вне замера
+/// и возвращает Kernel - одну итерацию замеряемой работы. Итерации повторяются,
+/// пока суммарное время не превысит --min-time.
+namespace bench {
+
+    struct Kernel {
+        std::function<void()> run;
+        /// счетчик оценок текущего потока, по которому считаются оценки в секунду:
+        /// полные оценки маршрута или отдельные вызовы get_time_dependent_cost
+        const uint64_t *evaluations = &InputData::path_evaluations;
+    };
+
+    using Setup = std::function<Kernel()>;
+
+    void Register(std::string name, Setup setup);
+
+    struct Registrar {
+        Registrar(std::string name, Setup setup) {
+            Register(std::move(name), std::move(setup));
+        }
+    };
+
+    template <typename T>
+    inline void DoNotOptimize(const T &value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    struct Result {
+        std::string name;
+        uint64_t iterations = 0;
+        double ns_per_iteration = 0;
+        /// оценок в секунду по счетчику Kernel::evaluations
+        double evaluations_per_second = 0;
+    };
+
+    /// Запускает зарегистрированные бенчмарки, чьё имя содержит @filter.
+    std::vector<Result> RunAll(const std::string &filter, double min_time_seconds);
+}
@@ -0,0 +1,310 @@
+#include "harness.hpp"
+
+#include "../include/batch_evaluator.hpp"
+#include "../include/crossover.hpp"
+#include "../include/statistics.hpp"
+#include "../include/first_step.hpp"
+#include "../include/init_population.hpp"
+#include "../include/vnd.hpp"
+#include "../utils/instance_generator.hpp"
+
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+
+namespace {
+    // количество точек для ядер второго шага: примерно такие подзадачи строит первый шаг
+    constexpr int kernel_sizes[] = {16, 48, 96};
+    constexpr int slice_counts[] = {4, 24};
+
+    const InputData &Instance(int n, int slices, int max_load) {
+        static std::map<std::tuple<int, int, int>, std::unique_ptr<InputData>> cache;
+        auto &input = cache[{n, slices, max_load}];
+        if (!input) {
+            GeneratorParameters params;
+            params.seed = n * 1000 + slices;
+            params.points_count = n;
+            params.slices = slices;
+            params.clusters = 3;
+            params.max_load_ratio = static_cast<double>(max_load) / (n - 1);
+            // ограничения мягче жадного маршрута, чтобы окрестности находили допустимые улучшения
+            params.time_tightness = 1.5;
+            params.distance_tightness = 1.5;
+            input = std::make_unique<InputData>(GenerateInstance(params));
+        }
+        return *input;
+    }
+
+    // случайный маршрут по всем точкам, как у подзадачи после первого шага
+    Solution RandomSolution(const InputData &input, uint32_t seed) {
+        std::mt19937 rng(seed);
+        Path tour(input.points_count + 1);
+        std::iota(tour.begin(), tour.end() - 1, 0);
+        tour.back() = 0;
+        std::shuffle(tour.begin() + 1, tour.end() - 1, rng);
+
+        Solution solution(std::move(tour));
+        auto [distance, time, score] = input.get_path_time_distance_score(solution.tour);
+        solution.distance = distance, solution.time = time, solution.score = score;
+        return solution;
+    }
+
+    std::string Suffix(int n, int slices) {
+        return "/N=" + std::to_string(n) + "/T=" + std::to_string(slices);
+    }
+
+    void RegisterEvaluation(int n, int slices) {
+        bench::Register("eval/get_time_dependent_cost" + Suffix(n, slices), [n, slices]() {
+            constexpr size_t lookups = 1024;
+            const auto &input = Instance(n, slices, n - 1);
+
+            std::mt19937 rng(n);
+            std::uniform_int_distribution<int> vertex(0, n - 1);
+            std::uniform_int_distribution<int64_t> time(0, InputData::time_duration * slices);
+            std::vector<std::tuple<int64_t, InputData::points_type, InputData::points_type>> queries(lookups);
+            for (auto &query: queries) {
+                query = {time(rng), vertex(rng), vertex(rng)};
+            }
+
+            return bench::Kernel{
+                .run = [&input, queries]() {
+                    int64_t sum = 0;
+                    for (const auto &[time, from, to]: queries) {
+                        sum += input.get_time_dependent_cost(time, from, to);
+                    }
+                    bench::DoNotOptimize(sum);
+                },
+                .evaluations = &InputData::cost_evaluations
+            };
+        });
+
+        bench::Register("eval/get_path_time_distance_score" + Suffix(n, slices), [n, slices]() {
+            const auto &input = Instance(n, slices, n - 1);
+            auto solution = RandomSolution(input, n);
+            return bench::Kernel{
+                .run = [&input, solution]() {
+                    bench::DoNotOptimize(input.get_path_time_distance_score(solution.tour));
+                }
+            };
+        });
+
+        // те же оценки пачками по BatchEvaluator::max_lanes маршрутов на каждом доступном наборе инструкций
+        for (auto backend: {BatchEvaluator::Backend::Scalar, BatchEvaluator::Backend::AVX2,
+                            BatchEvaluator::Backend::AVX512}) {
+            if (static_cast<int>(backend) > static_cast<int>(BatchEvaluator::Detect())) {
+                continue;
+            }
+            auto name = std::string("eval/get_path_time_distance_score/batch/") + BatchEvaluator::Name(backend);
+            bench::Register(name + Suffix(n, slices), [n, slices, backend]() {
+                const auto &input = Instance(n, slices, n - 1);
+                auto evaluator = std::make_shared<BatchEvaluator>(input);
+                evaluator->set_backend(backend);
+                auto solutions = std::make_shared<std::vector<Solution>>();
+                for (size_t i = 0; i < BatchEvaluator::max_lanes; ++i) {
+                    solutions->push_back(RandomSolution(input, n + i));
+                }
+                return bench::Kernel{
+                    .run = [evaluator, solutions]() {
+                        evaluator->evaluate(*solutions);
+                        bench::DoNotOptimize(solutions->data());
+                    }
+                };
+            });
+        }
+    }
+
+    void RegisterVnd(int n, int slices) {
+        static const std::pair<const char *, int> neighbourhoods[] = {
+            {"Shift", static_cast<int>(OptimizationType::Shift)},
+            {"SwapAdjacent", static_cast<int>(OptimizationType::SwapAdjacent)},
+            {"SwapAny", static_cast<int>(OptimizationType::SwapAny)},
+            {"TwoOpt", static_cast<int>(OptimizationType::TwoOpt)},
+            {"OrOpt", static_cast<int>(OptimizationType::OrOpt)},
+        };
+
+        for (const auto &[name, level]: neighbourhoods) {
+            bench::Register(std::string("vnd/") + name + Suffix(n, slices), [n, slices, level = level]() {
+                const auto &input = Instance(n, slices, n - 1);
+                auto solution = RandomSolution(input, n);
+                SetMoveBounds(nullptr);
+                return bench::Kernel{
+                    .run = [&input, solution, level]() {
+                        bench::DoNotOptimize(ApplyNeighbourhood(level, solution, input));
+                    }
+                };
+            });
+        }
+
+        for (const auto &[name, level]: neighbourhoods) {
+            bench::Register(std::string("vnd/") + name + "/move_bounds" + Suffix(n, slices), [n, slices, level = level]() {
+                const auto &input = Instance(n, slices, n - 1);
+                auto solution = RandomSolution(input, n);
+                // минимумы по срезам считаются один раз на поток решателя, поэтому вне замера;
+                // ядра без отсева выключают его при подготовке
+                SetMoveBounds(&input);
+                // полных оценок почти не остается, поэтому считаются ходы, проверенные оценкой
+                return bench::Kernel{
+                    .run = [&input, solution, level]() {
+                        bench::DoNotOptimize(ApplyNeighbourhood(level, solution, input));
+                    },
+                    .evaluations = &LocalStatistics().move_bound_checks
+                };
+            });
+        }
+
+        bench::Register("vnd/Perturbation" + Suffix(n, slices), [n, slices]() {
+            const auto &input = Instance(n, slices, n - 1);
+            auto solution = RandomSolution(input, n);
+            // DoubleBridge случаен, фиксированный seed делает замеры повторяемыми
+            SeedNeighbourhoods(n);
+            SetMoveBounds(nullptr);
+            return bench::Kernel{
+                .run = [&input, solution]() {
+                    bench::DoNotOptimize(Perturbation(solution, 1, 0.1, input));
+                }
+            };
+        });
+
+        bench::Register("vnd/Perturbation/batch" + Suffix(n, slices), [n, slices]() {
+            const auto &input = Instance(n, slices, n - 1);
+            auto solution = RandomSolution(input, n);
+            auto evaluator = std::make_shared<BatchEvaluator>(input);
+            SeedNeighbourhoods(n);
+            SetMoveBounds(nullptr);
+            return bench::Kernel{
+                .run = [&input, solution, evaluator]() {
+                    SetBatchEvaluator(evaluator.get());
+                    bench::DoNotOptimize(Perturbation(solution, 1, 0.1, input));
+                    SetBatchEvaluator(nullptr);
+                }
+            };
+        });
+    }
+
+    void RegisterCrossover(int n, int slices) {
+        for (auto type: crossover_types) {
+            const auto *name = SearchStatistics::crossover_names[static_cast<size_t>(type)];
+            bench::Register(std::string("crossover/") + name + Suffix(n, slices), [n, slices, type]() {
+                const auto &input = Instance(n, slices, n - 1);
+                auto first = RandomSolution(input, n);
+                auto second = RandomSolution(input, n + 1);
+                auto crossover = std::make_shared<Crossover>(n);
+                return bench::Kernel{
+                    .run = [&input, first, second, crossover, type]() {
+                        bench::DoNotOptimize(crossover->crossover(type, first, second, input));
+                    }
+                };
+            });
+
+            // BatchEvaluator::max_lanes потомков за итерацию с одной пакетной оценкой
+            bench::Register(std::string("crossover/") + name + "/batch" + Suffix(n, slices), [n, slices, type]() {
+                const auto &input = Instance(n, slices, n - 1);
+                auto parents = std::make_shared<std::vector<Solution>>();
+                for (size_t i = 0; i <= BatchEvaluator::max_lanes; ++i) {
+                    parents->push_back(RandomSolution(input, n + i));
+                }
+                std::vector<std::pair<const Solution *, const Solution *>> pairs;
+                for (size_t i = 0; i < BatchEvaluator::max_lanes; ++i) {
+                    pairs.emplace_back(&(*parents)[i], &(*parents)[i + 1]);
+                }
+                auto crossover = std::make_shared<Crossover>(n);
+                auto evaluator = std::make_shared<BatchEvaluator>(input);
+                auto children = std::make_shared<std::vector<Solution>>();
+                return bench::Kernel{
+                    .run = [&input, parents, pairs, crossover, evaluator, children, type]() {
+                        crossover->crossover_batch(type, pairs, input, *evaluator, *children);
+                        bench::DoNotOptimize(children->data());
+                    }
+                };
+            });
+        }
+    }
+
+    void RegisterInitPopulation(int n, int slices) {
+        bench::Register("init/grasp_tour" + Suffix(n, slices), [n, slices]() {
+            const auto &input = Instance(n, slices, n - 1);
+            auto initializer = std::make_shared<PopulationInitializer>(n);
+            initializer->prepare(n + 1, 15, input);
+            return bench::Kernel{
+                .run = [&input, initializer, n]() {
+                    Solution solution(0);
+                    initializer->grasp_tour(solution, n + 1, 15, input);
+                    bench::DoNotOptimize(solution);
+                }
+            };
+        });
+    }
+
+    void RegisterPopulation(int n, int slices) {
+        bench::Register("init/population" + Suffix(n, slices), [n, slices]() {
+            const auto &input = Instance(n, slices, n - 1);
+            auto initializer = std::make_shared<PopulationInitializer>(n);
+            auto first = RandomSolution(input, n);
+            return bench::Kernel{
+                .run = [&input, initializer, first, n]() {
+                    std::vector<Solution> population{first};
+                    initializer->initialize_population(n + 1, 20, 0.2, 15, input, population);
+                    bench::DoNotOptimize(population);
+                }
+            };
+        });
+
+        bench::Register("init/population/batch" + Suffix(n, slices), [n, slices]() {
+            const auto &input = Instance(n, slices, n - 1);
+            auto initializer = std::make_shared<PopulationInitializer>(n);
+            auto evaluator = std::make_shared<BatchEvaluator>(input);
+            auto first = RandomSolution(input, n);
+            return bench::Kernel{
+                .run = [&input, initializer, evaluator, first, n]() {
+                    std::vector<Solution> population{first};
+                    initializer->initialize_population(n + 1, 20, 0.2, 15, input, population, 1, evaluator.get());
+                    bench::DoNotOptimize(population);
+                }
+            };
+        });
+    }
+
+    template <size_t bitset_size>
+    void RegisterFirstStep(int n, int slices) {
+        constexpr int max_load = 8;
+        auto tier = bitset_size == std::numeric_limits<InputData::points_type>::max()
+                    ? std::string("max") : std::to_string(bitset_size);
+
+        bench::Register("first_step/bitset=" + tier + Suffix(n, slices), [n, slices]() {
+            const auto &input = Instance(n, slices, max_load);
+            return bench::Kernel{
+                .run = [&input]() {
+                    bench::DoNotOptimize(DoFirstStep<bitset_size, true>(input));
+                },
+                .evaluations = &InputData::cost_evaluations
+            };
+        });
+    }
+
+    const bool registered = []() {
+        for (int slices: slice_counts) {
+            for (int n: kernel_sizes) {
+                RegisterEvaluation(n, slices);
+            }
+            for (int n: kernel_sizes) {
+                RegisterVnd(n, slices);
+            }
+            for (int n: kernel_sizes) {
+                RegisterCrossover(n, slices);
+            }
+            for (int n: kernel_sizes) {
+                RegisterInitPopulation(n, slices);
+            }
+
+            RegisterPopulation(300, slices);
+
+            // для каждого размера bitset берем задачу, которая в него попала бы в Solver::FirstStep
+            RegisterFirstStep<128>(100, slices);
+            RegisterFirstStep<256>(200, slices);
+            RegisterFirstStep<512>(400, slices);
+            RegisterFirstStep<std::numeric_limits<InputData::points_type>::max()>(600, slices);
+        }
+        return true;
+    }();
+}
@@ -0,0 +1,115 @@
+#include "harness.hpp"
+
+#include <getopt.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// ./bench [--filter <substr>] [--min-time <seconds>] [--json <file>]
+int main(int argc, char *argv[]) {
+    std::string filter;
+    std::string json_path;
+    double min_time = 0.2;
+
+    static const option long_options[] = {
+        {"filter",   required_argument, nullptr, 'f'},
+        {"min-time", required_argument, nullptr, 'm'},
+        {"json",     required_argument, nullptr, 'j'},
+        {nullptr,    0,                 nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:m:j:", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'f': {
+                filter = optarg;
+                break;
+            }
+            case 'm': {
+                min_time = std::stod(optarg);
+                break;
+            }
+            case 'j': {
+                json_path = optarg;
+                break;
+            }
+            default: {
+                return -1;
+            }
+        }
+    }
+
+    std::printf("%-60s %12s %16s %16s\n", "benchmark", "iterations", "ns/iter", "evals/s");
+    auto results = bench::RunAll(filter, min_time);
+    for (const auto &result: results) {
+        std::printf("%-60s %12lu %16.0f %16.0f\n", result.name.c_str(), result.iterations,
+                    result.ns_per_iteration, result.evaluations_per_second);
+    }
+
+    // ядро того же имени без варианта @marker: ".../<marker>[/...]/N=.." -> ".../N=.."
+    auto reference_of = [&results](const std::string &name, const char *marker) {
+        const auto variant = name.find(marker);
+        const auto suffix = name.find("/N=");
+        if (variant == std::string::npos || suffix == std::string::npos || suffix < variant) {
+            return results.end();
+        }
+        const auto reference_name = name.substr(0, variant) + name.substr(suffix);
+        return std::find_if(results.begin(), results.end(),
+                            [&](const auto &other) { return other.name == reference_name; });
+    };
+
+    // ускорение пакетной оценки: ядро ".../batch[/<набор инструкций>]/N=.." против того же ядра без нее
+    bool header = false;
+    for (const auto &result: results) {
+        auto reference = reference_of(result.name, "/batch");
+        if (reference == results.end() || reference->evaluations_per_second <= 0) {
+            continue;
+        }
+        if (!header) {
+            std::printf("\n%-60s %16s %16s %8s\n", "batch evaluation", "evals/s", "scalar evals/s", "speedup");
+            header = true;
+        }
+        std::printf("%-60s %16.0f %16.0f %7.2fx\n", result.name.c_str(), result.evaluations_per_second,
+                    reference->evaluations_per_second,
+                    result.evaluations_per_second / reference->evaluations_per_second);
+    }
+
+    // отсев ходов по нижней оценке уменьшает число оценок, поэтому сравнивается время одного прохода
+    header = false;
+    for (const auto &result: results) {
+        auto reference = reference_of(result.name, "/move_bounds");
+        if (reference == results.end() || result.ns_per_iteration <= 0) {
+            continue;
+        }
+        if (!header) {
+            std::printf("\n%-60s %16s %16s %8s\n", "move bounds", "ns/iter", "full ns/iter", "speedup");
+            header = true;
+        }
+        std::printf("%-60s %16.0f %16.0f %7.2fx\n", result.name.c_str(), result.ns_per_iteration,
+                    reference->ns_per_iteration, reference->ns_per_iteration / result.ns_per_iteration);
+    }
+
+    if (!json_path.empty()) {
+        nlohmann::json j = nlohmann::json::array();
+        for (const auto &result: results) {
+            j.push_back({
+                {"name",                   result.name},
+                {"iterations",             result.iterations},
+                {"ns_per_iteration",       result.ns_per_iteration},
+                {"evaluations_per_second", result.evaluations_per_second}
+            });
+        }
+
+        std::ofstream file(json_path);
+        if (!file) {
+            std::cerr << "Can`t open output file to write benchmark results" << std::endl;
+            return -2;
+        }
+        file << j.dump(4);
+    }
+
+    return 0;
+}
@@ -1,18 +1,42 @@
 #pragma once
 
 #include "path.hpp"
+#include "statistics.hpp"
 
-struct IterInfo {
-    uint32_t distance;
-    uint32_t score;
-    uint64_t time;
-    uint64_t timestamp; // время в секундах, когда была сделана запись
-};
+#include <chrono>
+#include <functional>
+#include <limits>
+
+class Race;
+class CheckpointWriter;
 
 struct Context {
-    const ProgramArguments& args;
-    // const MetaParameters& params;
+    const MetaParameters& params;
+    /// момент времени, к которому нужно вернуть лучшее найденное решение
+    std::chrono::steady_clock::time_point deadline;
+    /// seed потока, из него выводятся генераторы всех частей алгоритма (Random::StreamSeed)
+    uint64_t seed = 0;
+    /// записывать каждое улучшение лучшего решения потока в @time_iterations
+    bool trace = false;
+    /// номер потока для записей трассы
+    uint32_t thread = 0;
+    /// момент, от которого отсчитывается время записей трассы
+    std::chrono::steady_clock::time_point trace_start;
     std::vector<IterInfo> time_iterations;
+    /// общее с другими потоками лучшее решение и отбор потоков, nullptr - поток работает один
+    Race *race = nullptr;
+    /// score лучшего допустимого решения потока
+    int64_t best_score = std::numeric_limits<int64_t>::min();
+    /// вызывается, когда решение потока стало общим лучшим в @race
+    std::function<void(const Solution &)> on_incumbent;
+    /// начальное решение - маршрут прошлого решения (Solver::SetWarmStart): половина популяции
+    /// строится его возмущениями
+    bool warm_start = false;
+    /// популяция потока между вызовами Solver::Solve: непустая - поиск продолжается с нее вместо
+    /// построения новой, по завершении сюда сохраняется итоговая; nullptr - не сохраняется
+    std::vector<Solution> *population = nullptr;
+    /// асинхронная запись чекпоинтов, в которую поток периодически отдает популяцию, nullptr - без них
+    CheckpointWriter *checkpoint = nullptr;
 };
 
 Solution applyTspTDPDP(Solution&& solution, const InputData &inputData, Context& ctx);
\ No newline at end of file
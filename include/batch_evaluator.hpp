@@ -0,0 +1,69 @@
+#pragma once
+
+#include "path.hpp"
+#include "../utils/problem_arguments.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Пакетная оценка маршрутов одной длины: маршруты идут в SIMD-лентах, переходы берутся gather-ами
+/// из плоских копий матриц. Время перехода считается той же целочисленной интерполяцией, что и
+/// InputData::get_time_dependent_cost, поэтому результат совпадает с get_path_time_distance_score.
+/// Набор инструкций выбирается при создании по возможностям процессора: AVX-512 (два регистра
+/// по 8 маршрутов), AVX2 (два по 4), иначе скалярная оценка по одному маршруту.
+class BatchEvaluator {
+public:
+    enum class Backend {
+        Scalar = 0,
+        AVX2,
+        AVX512,
+    };
+
+    /// маршрутов за один проход самого широкого набора инструкций
+    static constexpr size_t max_lanes = 16;
+
+    explicit BatchEvaluator(const InputData &input);
+
+    /// лучший набор инструкций, доступный на этом процессоре
+    static Backend Detect();
+
+    static const char *Name(Backend backend);
+
+    Backend backend() const {
+        return selected;
+    }
+
+    /// Выбор набора инструкций для замеров. Недоступный процессору набор или задача, индексы
+    /// которой не помещаются в int32 или суммы по маршруту не точны в double, оцениваются скалярно.
+    void set_backend(Backend backend);
+
+    /// Оценивает маршруты @solutions[0..count), заполняя distance, time и score.
+    /// Маршруты разной длины оцениваются скалярно.
+    void evaluate(Solution *const *solutions, size_t count);
+
+    void evaluate(std::vector<Solution> &solutions);
+
+private:
+    /// индексы матриц помещаются в int32, а суммы по любому маршруту - целые меньше 2^52
+    bool Fits() const;
+
+    const InputData &input;
+    size_t points;
+    size_t slices;
+    Backend selected = Backend::Scalar;
+    /// задача проходит Fits, иначе оценка всегда скалярная
+    bool vectorizable;
+    /// процессор умеет AVX2, небольшие пачки при AVX-512 считаются в его лентах
+    bool narrow_available = false;
+
+    // плоские копии матриц в double: все значения и промежуточные суммы - целые меньше 2^53
+    std::vector<double> time;
+    std::vector<double> distance;
+    /// время обслуживания и важность по номеру вершины, у склада 0
+    std::vector<double> service;
+    std::vector<double> score;
+
+    /// маршруты прохода по лентам: lane_vertices[i * lanes + lane] - i-я вершина маршрута ленты
+    std::vector<int32_t> lane_vertices;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+/// Общий для всех потоков флаг досрочной остановки поиска. Его проверяют DoFirstStep (на каждом слое),
+/// начальная популяция, VND, VNS и цикл ГА вместе с дедлайном: поиск сворачивается и возвращает
+/// лучшее найденное. Пока остановка не запрошена, проверка стоит одной загрузки атомарного флага.
+namespace Cancellation {
+    inline std::atomic<bool> requested{false};
+
+    inline bool Requested() {
+        return requested.load(std::memory_order_relaxed);
+    }
+
+    void Request();
+
+    /// снимает запрос, например перед следующей задачей
+    void Reset();
+
+    /// SIGINT и SIGTERM запрашивают остановку; повторный сигнал завершает процесс как обычно
+    void InstallSignalHandlers();
+
+    /// Фоновая проверка раз в @poll_ms миллисекунд: остановка, когда появится файл @path
+    void WatchStopFile(const std::string &path, int poll_ms = 50);
+
+    /// Фоновое чтение stdin: остановка по строке "stop". Конец ввода остановкой не считается.
+    void WatchStdin();
+}
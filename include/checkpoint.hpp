@@ -0,0 +1,106 @@
+#pragma once
+
+#include "first_step.hpp"
+#include "path.hpp"
+#include "../utils/problem_arguments.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Race;
+
+/// Снимок состояния решателя, с которого долгий запуск продолжается после падения или вытеснения.
+///
+/// Бинарный файл, все числа little-endian, как в BinaryParser:
+///  - магия "TDCK" и версия формата (uint32);
+///  - отпечаток задачи, seed (uint64), поколение (uint32);
+///  - потраченное время второго шага в микросекундах (uint64) и лучший score (int64);
+///  - количество ответов первого шага (uint32), для каждого value, distance, time (int64) и маршрут;
+///  - для каждого ответа количество решений популяции (uint32), для каждого distance, time (uint32),
+///    score (int64) и маршрут.
+/// Маршрут - длина (uint32) и вершины (uint16).
+struct Checkpoint {
+    uint64_t fingerprint = 0;
+    uint64_t seed = 0;
+    /// сколько раз запуск уже продолжался с чекпоинта: от него зависят seed потоков продолжения,
+    /// чтобы они не повторяли случайные решения прерванного запуска
+    uint32_t generation = 0;
+    uint64_t elapsed_us = 0;
+    /// лучший score на момент записи, только для сведения: при продолжении срезы могут быть другими,
+    /// поэтому поиск его не использует
+    int64_t incumbent = std::numeric_limits<int64_t>::min();
+    std::vector<FirstStepAnswer> answers;
+    /// популяции потоков по ответам первого шага в нумерации подзадач, пустая - поток ее еще не построил
+    std::vector<std::vector<Solution>> populations;
+};
+
+namespace CheckpointFile {
+    /// Отпечаток задачи по размерам, ограничениям, важностям, временам обслуживания и расстояниям.
+    /// Срезы time_matrix в него не входят: после продолжения популяции все равно переоцениваются.
+    uint64_t Fingerprint(const InputData &input);
+
+    /// пишет во временный файл @path.tmp, сбрасывает его на диск и переименовывает, затем сбрасывает
+    /// каталог, так что на диске всегда целый чекпоинт
+    bool Write(const std::string &path, const Checkpoint &checkpoint);
+
+    /// маршруты длиннее @points_count + 1 и слишком большие популяции - повреждение файла,
+    /// они отвергаются до выделения памяти
+    bool Read(const std::string &path, size_t points_count, Checkpoint &checkpoint);
+}
+
+/// Асинхронная запись чекпоинтов во время Solver::Solve.
+///
+/// Потоки поиска не чаще раза в @interval отдают копию своей популяции (publish), под блокировкой
+/// она только перекладывается. Отдельный поток раз в @interval собирает снимок и пишет файл,
+/// поэтому поиск никогда не ждет диска. Первый снимок с ответами первого шага пишется сразу,
+/// последний - в stop (или при уничтожении объекта).
+class CheckpointWriter {
+public:
+    /// @base - ответы первого шага, seed и поколение; время и лучший score берутся из @race и @start
+    CheckpointWriter(std::string path, std::chrono::milliseconds interval, Checkpoint base, const Race &race,
+                     std::chrono::steady_clock::time_point start);
+
+    ~CheckpointWriter();
+
+    /// пора ли потоку @thread отдать популяцию. Вызывается только из потока @thread
+    bool due(size_t thread) const {
+        return std::chrono::steady_clock::now() >= next_publish[thread];
+    }
+
+    /// копия популяции потока @thread в нумерации его подзадачи для следующего снимка
+    void publish(size_t thread, const std::vector<Solution> &population);
+
+    /// пишет последний снимок и останавливает поток записи, повторный вызов ничего не делает
+    void stop();
+
+    /// записанные файлы чекпоинтов
+    size_t written() const;
+
+private:
+    void run();
+
+    /// пишет текущий снимок, вызывается без блокировки
+    void write();
+
+    std::string path;
+    std::chrono::milliseconds interval;
+    const Race &race;
+    std::chrono::steady_clock::time_point start;
+    /// время второго шага, потраченное до продолжения
+    uint64_t elapsed_before;
+    std::vector<std::chrono::steady_clock::time_point> next_publish;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    Checkpoint checkpoint;
+    bool dirty = true;
+    bool stopping = false;
+    size_t files = 0;
+    std::thread writer;
+};
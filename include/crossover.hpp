@@ -1,21 +1,164 @@
 #pragma once
 
 #include "path.hpp"
+#include "../utils/random.hpp"
+#include <array>
+#include <limits>
 #include <random>
+#include <utility>
+#include <vector>
+
+class BatchEvaluator;
+
+/// Реестр операторов рекомбинации. Новый оператор добавляется значением здесь, именем в
+/// SearchStatistics::crossover_names и строкой в Crossover::operators.
+enum class CrossoverType: int {
+    EXX = 0,
+    PMX,
+    SC,
+    OX,
+    EAX,
+    TDMerge,
+};
+
+inline constexpr std::array<CrossoverType, 6> crossover_types = {
+    CrossoverType::EXX, CrossoverType::PMX, CrossoverType::SC,
+    CrossoverType::OX, CrossoverType::EAX, CrossoverType::TDMerge,
+};
 
 class Crossover {
-private:
-    std::mt19937 rng;
 public:
 
-    Crossover() : rng(std::random_device{}()) {};
+    Crossover() : rng(Random::NondeterministicSeed()) {};
 
+    explicit Crossover(uint64_t seed) : rng(seed) {};
+
+    /// кроссовер, выбранный адаптивно по успешности операторов на единицу процессорного времени
     Solution crossover(const Solution &first, const Solution &second, const InputData &inputData);
 
+    /// кроссовер заданного типа, результат уже оценен по @inputData
+    Solution crossover(CrossoverType type, const Solution &first, const Solution &second, const InputData &inputData);
+
+    /// Потомки пар @parents оператором @type, те же, что у crossover(type, ...), но оцененные
+    /// одним вызовом @evaluator, построенного по @inputData. Адаптивный выбор не затрагивается.
+    void crossover_batch(CrossoverType type, const std::vector<std::pair<const Solution *, const Solution *>> &parents,
+                         const InputData &inputData, BatchEvaluator &evaluator, std::vector<Solution> &children);
+
+    /// Кроссовер, выбранный адаптивно, сразу для нескольких пар @parents: потомки оцениваются одним
+    /// вызовом @evaluator, возвращается лучший по score. Итог, как и у crossover, отдается в report.
+    Solution crossover(const std::vector<std::pair<const Solution *, const Solution *>> &parents,
+                       const InputData &inputData, BatchEvaluator &evaluator);
+
+    /// Итог последнего кроссовера для адаптивного выбора: @reward - 0 если потомок отброшен,
+    /// 1 если попал в популяцию, 2 если стал лучшим. Время оператора считается от начала
+    /// кроссовера до этого вызова, то есть вместе с доводкой потомка.
+    void report(double reward);
+
+    /// тип последнего примененного кроссовера
+    CrossoverType last_type() const {
+        return last_applied;
+    }
+
 private:
-    Solution PMX(const Solution &first, const Solution &second);
+    using vertexIdxType = Vertex;
+    static constexpr vertexIdxType no_vertex = std::numeric_limits<vertexIdxType>::max();
+
+    struct Operator {
+        CrossoverType type;
+        /// строит маршрут потомка, оценку делает crossover()
+        Solution (Crossover::*build)(const Solution &first, const Solution &second, const InputData &inputData);
+    };
+
+    static const std::array<Operator, crossover_types.size()> operators;
+
+    /// скользящие средние награды и процессорного времени оператора
+    struct OperatorScore {
+        double reward = 0;
+        double cpu_us = 0;
+        uint64_t reports = 0;
+    };
+
+    /// вес нового замера в скользящем среднем
+    static constexpr double score_decay = 0.1;
+    /// минимальная вероятность выбора оператора, чтобы продолжать пробовать отстающие
+    static constexpr double min_probability = 0.05;
+    /// сколько раз оператор запускается, прежде чем его вес начинает учитываться
+    static constexpr uint64_t warmup_reports = 2;
+
+    CrossoverType select();
+
+    /// маршрут потомка оператором @type без оценки
+    Solution build(CrossoverType type, const Solution &first, const Solution &second, const InputData &inputData);
+
+    Random::Generator rng;
+    CrossoverType last_applied = CrossoverType::EXX;
+    std::array<OperatorScore, crossover_types.size()> scores{};
+    /// процессорное время потока в начале последнего кроссовера, ожидающего report()
+    uint64_t pending_start_us = 0;
+    bool pending = false;
+    /// потомки последнего пакетного кроссовера, чтобы не выделять память на каждой итерации
+    std::vector<Solution> batch_children;
+
+    Solution PMX(const Solution &first, const Solution &second, const InputData &inputData);
+
+    Solution EXX(const Solution &first, const Solution &second, const InputData &inputData);
+
+    Solution SC(const Solution &first, const Solution &second, const InputData &inputData);
+
+    /// order crossover: отрезок первого родителя, остальные вершины в порядке второго
+    Solution OX(const Solution &first, const Solution &second, const InputData &inputData);
+
+    /// EAX с одним AB-циклом: ребра первого родителя на цикле заменяются ребрами второго,
+    /// получившиеся подтуры сливаются жадно по distance_matrix
+    Solution EAX(const Solution &first, const Solution &second, const InputData &inputData);
+
+    /// жадная сборка по времени: из текущей вершины идем к ближайшему по времени прибытия
+    /// кандидату среди последователей в родителях и вершины с наименьшим средним временем
+    /// прибытия в родителях
+    Solution TDMerge(const Solution &first, const Solution &second, const InputData &inputData);
+
+    /// увеличивает буферы под маршрут длины @path_size, после первого вызова на этом размере не аллоцирует
+    void prepare(size_t path_size);
+
+    void add_successor(vertexIdxType from, vertexIdxType to);
+
+    void pool_remove(vertexIdxType vertex);
+
+    vertexIdxType pool_random();
+
+    /// соседи вершин маршрута в цикле (депо замыкает маршрут), @result[2 * v] - предыдущая, @result[2 * v + 1] - следующая
+    static void fill_neighbours(const Path &tour, std::vector<vertexIdxType> &result);
+
+    /// EAX: заменяет соседа @from вершины @vertex в промежуточном решении на @to
+    void replace_neighbour(vertexIdxType vertex, vertexIdxType from, vertexIdxType to);
 
-    Solution EXX(const Solution &first, const Solution &second);
+    // Рабочие буферы операторов, индексируются номером вершины. Операторы предполагают, что
+    // вершины маршрута - 0..path_size-2, как у подзадачи второго шага.
 
-    Solution SC(const Solution &first, const Solution &second);
+    /// EXX: до двух последователей вершины в родителях, successors[2 * v], successors[2 * v + 1]
+    std::vector<vertexIdxType> successors;
+    std::vector<uint8_t> successors_count;
+    /// EXX: непосещенные вершины, pool[pool_position[v]] == v пока v в пуле
+    std::vector<vertexIdxType> pool;
+    std::vector<size_t> pool_position;
+    size_t pool_size = 0;
+    /// PMX: отображение вершин отрезка первого родителя во второй, no_vertex - нет отображения
+    std::vector<vertexIdxType> mapping;
+    /// SC: сумма позиций вершины, начала корзин сортировки подсчетом и итоговый порядок
+    std::vector<uint32_t> position_sum;
+    std::vector<uint32_t> bucket_start;
+    std::vector<vertexIdxType> order;
+    /// OX, EAX, TDMerge: отметки вершин
+    std::vector<uint8_t> marked;
+    /// EAX: соседи вершины в цикле первого и второго родителя и в промежуточном решении,
+    /// neighbours[2 * v], neighbours[2 * v + 1]
+    std::vector<vertexIdxType> first_neighbours;
+    std::vector<vertexIdxType> second_neighbours;
+    std::vector<vertexIdxType> neighbours;
+    /// EAX: вершины AB-цикла по порядку обхода и номер подтура вершины
+    std::vector<vertexIdxType> cycle;
+    std::vector<uint32_t> subtour;
+    std::vector<uint32_t> subtour_size;
+    /// TDMerge: время прибытия в вершину в каждом из родителей
+    std::vector<int64_t> arrival;
 };
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "../utils/problem_arguments.hpp"
+
+/// Режим демона: принимает запросы в формате json, по одному на строку,
+/// через unix-сокет @args.daemon_socket (или stdin, если путь равен "-")
+/// и отвечает json решения на той же строке-канале.
+///
+/// Формат запроса:
+///  - "instance" - задача целиком, либо "instance_path" - путь до json файла с задачей,
+///    либо "instance_id" - идентификатор (хэш задачи в бинарном формате) уже присланной задачи;
+///  - "time" - время работы второго шага в секундах (по умолчанию из -t, без него 10);
+///  - "meta" - переопределение мета-параметров (поля как в MetaParameters);
+///  - "point_scores" - полная замена скоров точек, "score_overrides" - {"<точка>": скор};
+///  - "warm_start" - маршрут прошлого решения для теплого старта, "warm_start_neighbours" - DP первого
+///    шага только по его окрестности (0 - без DP), см. Solver::SetWarmStart;
+///  - "seed" - seed генераторов случайных чисел (по умолчанию из --seed или случайный);
+///  - "stats" - true, чтобы вернуть статистику поиска (как в --stats);
+///  - "trace" - true, чтобы вернуть трассу сходимости (как в --trace);
+///  - "id" - произвольное значение, возвращается в ответе без изменений.
+///
+/// Ответ - поля OutData, "instance_id", "id", "stats" и "trace" по запросу, либо "error" с описанием ошибки.
+int RunDaemon(const ProgramArguments &args);
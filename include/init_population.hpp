@@ -2,31 +2,90 @@
 
 #include "path.hpp"
 #include "../utils/problem_arguments.hpp"
+#include "../utils/random.hpp"
 
 #include <random>
 #include <algorithm>
 
+class BatchEvaluator;
+
 class PopulationInitializer {
 private:
-    std::mt19937 rng;
+    Random::Generator rng;
     static constexpr size_t max_iterations = 1000;
+    /// попыток на поток в одной пачке параллельной генерации
+    static constexpr size_t attempts_per_thread = 8;
+    /// минимальная длина списка ближайших соседей вершины, короче списки не строятся
+    static constexpr size_t min_neighbours = 32;
+    /// сколько непосещенных соседей из списка оценивается по времени на каждый кандидат RCL
+    static constexpr int candidates_per_rcl_slot = 2;
 
 public:
-    PopulationInitializer() : rng(std::random_device{}()) {}
+    PopulationInitializer() : rng(Random::NondeterministicSeed()) {}
+
+    explicit PopulationInitializer(uint64_t seed) : rng(seed) {}
 
+    /// Дополняет @population до @population_size допустимыми маршрутами без повторов.
+    /// Каждая попытка строится своим генератором с seed по номеру попытки, попытки считаются
+    /// пачками в @threads потоках и принимаются по порядку номеров, поэтому результат
+    /// не зависит от @threads. С @evaluator (построенным по @inputData) маршруты пачки
+    /// оцениваются им одним вызовом, в одном потоке пачка - BatchEvaluator::max_lanes попыток.
     void initialize_population(int path_size,
                                int population_size,
                                double beta,
                                int alpha,
                                const InputData &inputData,
-                               std::vector<Solution> &population);
+                               std::vector<Solution> &population,
+                               size_t threads = 1,
+                               BatchEvaluator *evaluator = nullptr);
+
+    /// Списки ближайших соседей для RCL grasp_tour на маршрутах длины @n по @input и минимумы времени
+    /// перехода по срезам для раннего отсева недопустимых попыток. Пока не вызван или вызван
+    /// для другого @n, RCL строится перебором всех непосещенных вершин.
+    void prepare(int n, int alpha, const InputData &input);
+
+    /// случайная перестановка вершин 1..n-2 между двумя депо
+    void random_tour(Solution &solution, int n, const InputData &input);
+
+    /// жадно-случайный путь: следующая вершина выбирается среди @alpha ближайших по времени
+    void grasp_tour(Solution &solution, int n, int alpha, const InputData &input);
 
 private:
+    /// попытка построения маршрута в пачке
+    struct Attempt {
+        Solution solution{0};
+        uint64_t hash = 0;
+        /// хэш совпал с маршрутом популяции, маршрут не оценивался
+        bool duplicate = false;
+        /// построение прервано: нижняя оценка времени или расстояние уже вышли за ограничения
+        bool infeasible = false;
+    };
+
+    /// строит попытку с seed @seed, маршрут с хэшем из @known отбрасывается до оценки,
+    /// без @evaluate маршрут остается неоцененным для пакетной оценки
+    void build_attempt(Attempt &attempt, uint64_t seed, int path_size, double beta, int alpha,
+                       const InputData &inputData, const std::vector<uint64_t> &known, bool evaluate);
+
+    void random_path(Path &tour, int n);
+
+    /// @stop_infeasible - прервать построение и вернуть false, когда маршрут заведомо недопустим
+    bool grasp_path(Path &tour, int n, int alpha, const InputData &input, bool stop_infeasible);
+
     double generate_random_double();
 
     int generate_random_int(int min, int max);
 
-    void random_tour(Solution &solution, int n, const InputData &input);
+    // рабочие буферы grasp_path
+    std::vector<uint8_t> visited;
+    std::vector<std::pair<int64_t, Vertex>> candidates;
 
-    void grasp_tour(Solution &solution, int n, int alpha, const InputData &input);
+    /// ближайшие соседи вершины по среднему по срезам времени перехода,
+    /// neighbours[v * neighbours_count + k], пустые если neighbours_points != n
+    std::vector<Vertex> neighbours;
+    size_t neighbours_count = 0;
+    int neighbours_points = 0;
+    /// минимум времени перехода по всем срезам, min_travel[from * (n - 1) + to]: интерполированное
+    /// время не меньше него, поэтому сумма по маршруту - нижняя оценка времени
+    std::vector<int64_t> min_travel;
+    int bounds_points = 0;
 };
@@ -47,6 +47,31 @@ struct Solution {
     }
 };
 
+/// Ключ Zobrist для вершины @vertex на позиции @position: перемешивание SplitMix64 пары,
+/// поэтому таблица ключей не хранится и подходит для маршрутов любой длины
+inline uint64_t ZobristKey(size_t position, Vertex vertex) {
+    uint64_t z = (static_cast<uint64_t>(position) << 16 | vertex) + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/// Zobrist-хэш позиций [@from, @to) маршрута. Ход, меняющий только эти позиции, пересчитывает
+/// хэш маршрута как hash ^ TourHashRange(old, from, to) ^ TourHashRange(new, from, to).
+inline uint64_t TourHashRange(const Path &tour, size_t from, size_t to) {
+    uint64_t hash = 0;
+    for (size_t i = from; i < to; ++i) {
+        hash ^= ZobristKey(i, tour[i]);
+    }
+    return hash;
+}
+
+/// Хэш маршрута для быстрого отсева дубликатов и кэша оценок: равные маршруты имеют
+/// равный хэш, совпадение хэшей разных маршрутов маловероятно
+inline uint64_t TourHash(const Path &tour) {
+    return TourHashRange(tour, 0, tour.size());
+}
+
 inline std::ostream &operator<<(std::ostream &os, const Solution &solution) {
     os << "Solution size: " << solution.tour.size() << "\n";
     os << "Solution score: " << solution.score << "\n";
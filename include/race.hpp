@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../utils/problem_arguments.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+/// Общее состояние потоков второго шага.
+///
+/// Лучший score допустимого решения среди всех потоков хранится в одном атомике без блокировок:
+/// поток, чей набор вершин по верхней оценке не может его превзойти, заканчивает работу.
+/// При включенных гонках (@first_rung > 0) потоки проходят отбор последовательным делением пополам:
+/// после first_rung * 2^k итераций GA поток ждет остальных на ступени k, и продолжает только лучшая
+/// половина по score; выжившим число итераций без улучшения увеличивается вдвое за каждую ступень.
+/// Решение на ступени зависит только от score потоков, поэтому при том же seed отбор повторяем.
+class Race {
+public:
+    Race(size_t threads, size_t first_rung);
+
+    /// score лучшего допустимого решения среди всех потоков
+    int64_t incumbent() const {
+        return best.load(std::memory_order_relaxed);
+    }
+
+    /// предлагает score допустимого решения, true - он стал общим лучшим
+    bool offer(int64_t score);
+
+    /// Поток @thread с верхней оценкой score @upper_bound не может улучшить общее лучшее решение.
+    /// Отмечает поток как безнадежный, если это так.
+    bool hopeless(size_t thread, int64_t upper_bound);
+
+    /// Поток @thread закончил @iteration итераций GA с лучшим допустимым score @score.
+    /// На ступени ждет остальных потоков до @deadline, false - поток выбыл из гонки.
+    bool advance(size_t thread, uint64_t iteration, int64_t score, std::chrono::steady_clock::time_point deadline);
+
+    /// множитель допустимого числа итераций без улучшения для потока @thread
+    int patience(size_t thread) const;
+
+    /// поток закончил работу и больше не участвует в ступенях
+    void finish(size_t thread);
+
+    /// итог потока для статистики
+    struct Outcome {
+        /// пройденные ступени
+        uint32_t rungs = 0;
+        /// выбыл на ступени
+        bool eliminated = false;
+        /// остановлен по верхней оценке
+        bool hopeless = false;
+    };
+
+    Outcome outcome(size_t thread) const;
+
+private:
+    struct Lane {
+        Outcome outcome;
+        bool active = true;
+        /// ступень, на которой поток ждет, и его score на ней
+        int64_t rung = -1;
+        int64_t score = std::numeric_limits<int64_t>::min();
+    };
+
+    /// Решение по ступени @rung, если все активные потоки дошли до нее. Вызывается под mutex.
+    void decide(int64_t rung);
+
+    std::atomic<int64_t> best{std::numeric_limits<int64_t>::min()};
+
+    size_t first_rung;
+    mutable std::mutex mutex;
+    std::condition_variable decided;
+    std::vector<Lane> lanes;
+    /// последняя ступень, по которой принято решение
+    int64_t decided_rung = -1;
+};
+
+/// Верхняя оценка score маршрута через все точки @input: сумма важностей минус для каждой точки
+/// и склада минимальное по срезам время перехода в нее из другой точки
+int64_t ScoreUpperBound(const InputData &input);
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "first_step.hpp"
+#include "path.hpp"
+#include "statistics.hpp"
+#include "../utils/problem_arguments.hpp"
+#include "../utils/random.hpp"
+
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+struct SolverResult {
+    /// лучшее решение в исходной нумерации вершин, пустой маршрут если решения нет
+    Solution solution{0};
+    SolverStatistics statistics;
+    /// улучшения лучших решений всех потоков в порядке времени, заполняется если включена трасса
+    std::vector<IterInfo> trace;
+};
+
+/// Маршрут прошлого решения, с которого начинается повторное планирование
+struct WarmStart {
+    /// маршрут в исходной нумерации вершин от склада до склада
+    std::vector<FirstStepAnswer::points_type> route;
+    /// DP первого шага: nullopt - по всей задаче, 0 - пропускается, иначе только по вершинам маршрута
+    /// и @neighbours ближайшим по времени перехода к каждой из них
+    std::optional<size_t> neighbours;
+};
+
+/// Новые значения нескольких срезов time_matrix, например по обновлению пробок
+struct SliceDelta {
+    struct Slice {
+        /// номер среза в time_matrix
+        size_t index = 0;
+        /// матрица points_count x points_count
+        std::vector<std::vector<int64_t>> times;
+    };
+    std::vector<Slice> slices;
+};
+
+/// Решатель без файлового ввода-вывода для встраивания в другие сервисы.
+/// Задача не копируется: @input принадлежит вызывающему и должна жить, пока жив решатель.
+/// Копия делается только при первом ApplySliceDelta, дальше решатель работает с ней.
+class Solver {
+public:
+    using Clock = std::chrono::steady_clock;
+    /// новое лучшее допустимое решение среди всех потоков в исходной нумерации вершин
+    /// и микросекунды от запуска первого шага
+    using IncumbentCallback = std::function<void(const Solution &solution, uint64_t elapsed_us)>;
+
+    Solver(const InputData &input, const MetaParameters &params) : input(input), params(params) {}
+
+    /// Первый шаг: наборы вершин из DP, считается один раз при первом вызове.
+    const std::vector<FirstStepAnswer> &FirstStep();
+
+    /// Второй шаг: оптимизация каждого набора вершин в отдельном потоке до @deadline.
+    /// Если первый шаг еще не выполнен, он выполняется целиком до начала второго.
+    /// Повторный вызов продолжает поиск с популяций, на которых остановился предыдущий.
+    SolverResult Solve(Clock::time_point deadline);
+
+    /// Заменяет срезы time_matrix из @delta между вызовами Solve. Первый шаг не повторяется: ответы
+    /// первого шага переоцениваются, в подзадачах потоков пересчитываются только замененные срезы,
+    /// а следующий Solve переоценивает сохраненные популяции, выбрасывает ставшие недопустимыми решения
+    /// и продолжает с остальных. false - номер среза или размер матрицы не подходит к задаче.
+    bool ApplySliceDelta(const SliceDelta &delta);
+
+    /// Записывать трассу сходимости в SolverResult::trace. Выключена по умолчанию,
+    /// тогда поиск не тратит на нее ничего, кроме одной проверки флага на улучшение.
+    void EnableTrace(bool enabled = true) {
+        trace = enabled;
+    }
+
+    /// Seed всех генераторов случайных чисел. По умолчанию выбирается случайно,
+    /// использованное значение возвращается в SolverStatistics::seed.
+    void SetSeed(uint64_t value) {
+        seed = value;
+    }
+
+    /// Теплый старт: маршрут @warm_start.route проверяется и пересчитывается по текущей задаче. Если он
+    /// нарушает ограничения (например, изменились срезы времени), из него по одной выбрасываются вершины,
+    /// пока он не станет допустимым. Маршрут становится первым ответом первого шага, и в популяцию его
+    /// потока кроме него добавляются возмущенные варианты. Вызывается до FirstStep, false - маршрут
+    /// не подходит к задаче.
+    bool SetWarmStart(WarmStart warm_start);
+
+    /// Во время Solve раз в @interval асинхронно писать чекпоинт в @path, см. CheckpointWriter
+    void EnableCheckpoints(std::string path, std::chrono::milliseconds interval) {
+        checkpoint_path = std::move(path);
+        checkpoint_interval = interval;
+    }
+
+    /// Продолжение прерванного запуска с чекпоинта @path: вместо первого шага берутся его ответы,
+    /// переоцененные по текущей задаче, потоки продолжают с сохраненных популяций. Если срезы времени
+    /// изменились так, что ни один ответ не укладывается в ограничения, первый шаг повторяется. Вызывается до FirstStep, false - файл поврежден
+    /// или записан для другой задачи.
+    bool Resume(const std::string &path);
+
+    /// время второго шага, потраченное до продолжения с чекпоинта: его вычитают из бюджета времени
+    uint64_t ResumedElapsedUs() const {
+        return resumed_elapsed_us;
+    }
+
+    /// Обработчик каждого нового лучшего решения второго шага, например для потоковой выдачи.
+    /// Вызывается из потоков поиска по одному, score в последовательных вызовах строго растет.
+    void SetIncumbentCallback(IncumbentCallback callback) {
+        incumbent_callback = std::move(callback);
+    }
+
+private:
+    /// задача с примененными обновлениями срезов
+    const InputData &instance() const {
+        return updated.has_value() ? *updated : input;
+    }
+
+    /// пересчет метрик ответов первого шага и теплого старта по текущей задаче: их наборы вершин
+    /// остаются, а срезы времени могли измениться
+    void RescoreAnswers();
+
+    const InputData &input;
+    /// копия задачи, появляется при первом обновлении срезов
+    std::optional<InputData> updated;
+    MetaParameters params;
+
+    bool trace = false;
+    uint64_t seed = Random::NondeterministicSeed();
+    IncumbentCallback incumbent_callback;
+    /// упорядочивает вызовы incumbent_callback
+    std::mutex incumbent_mutex;
+    int64_t published_score = 0;
+    /// момент первого запуска первого шага, от него считается время записей трассы
+    Clock::time_point start;
+
+    /// пересчитанный маршрут теплого старта и режим DP для него
+    std::optional<FirstStepAnswer> warm_answer;
+    std::optional<size_t> warm_neighbours;
+    /// первый ответ первого шага - маршрут теплого старта
+    bool warm_first = false;
+
+    bool first_step_done = false;
+    std::vector<FirstStepAnswer> first_step_answers;
+
+    std::string checkpoint_path;
+    std::chrono::milliseconds checkpoint_interval{0};
+    /// сколько раз запуск продолжался с чекпоинта, с чем он продолжен
+    uint32_t generation = 0;
+    uint64_t resumed_elapsed_us = 0;
+
+    /// состояние потока второго шага между вызовами Solve
+    struct SearchState {
+        /// вершины ответа первого шага, i-я вершина подзадачи - points[i] исходной задачи
+        std::vector<FirstStepAnswer::points_type> points;
+        InputData sub_input;
+        std::vector<Solution> population;
+    };
+    /// по ответу первого шага, пустое до первого Solve
+    std::vector<SearchState> states;
+    SolverStatistics statistics;
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+/// Счетчики поиска одного потока. Пишутся без синхронизации в thread_local экземпляр
+/// (LocalStatistics), после завершения потока сливаются в SolverStatistics.
+struct SearchStatistics {
+    /// имена окрестностей VND в порядке OptimizationType, уровни больше OrOpt считаются как OrOpt
+    static constexpr std::array<const char *, 5> neighbourhood_names = {
+        "Shift", "SwapAdjacent", "SwapAny", "TwoOpt", "OrOpt"
+    };
+    /// имена кроссоверов в порядке CrossoverType
+    static constexpr std::array<const char *, 6> crossover_names = {"EXX", "PMX", "SC", "OX", "EAX", "TDMerge"};
+
+    /// длительность фаз второго шага в микросекундах, при слиянии суммируется по потокам
+    uint64_t population_init_us = 0;
+    uint64_t initial_vns_us = 0;
+    uint64_t ga_loop_us = 0;
+
+    /// полные оценки маршрута и вызовы get_time_dependent_cost
+    uint64_t path_evaluations = 0;
+    uint64_t cost_evaluations = 0;
+
+    /// проходы окрестностей внутри VND и сколько из них улучшили текущее решение
+    std::array<uint64_t, neighbourhood_names.size()> vnd_applied{};
+    std::array<uint64_t, neighbourhood_names.size()> vnd_accepted{};
+    /// проходы окрестностей в Perturbation и сколько из них дали принятое возмущение
+    std::array<uint64_t, neighbourhood_names.size()> perturbation_applied{};
+    std::array<uint64_t, neighbourhood_names.size()> perturbation_accepted{};
+    /// суммарный прирост score и процессорное время проходов окрестности в VND и Perturbation,
+    /// по их отношению настраивается адаптивный выбор окрестностей
+    std::array<int64_t, neighbourhood_names.size()> neighbourhood_gain{};
+    std::array<uint64_t, neighbourhood_names.size()> neighbourhood_cpu_us{};
+
+    /// запуски кроссоверов и сколько потомков попало в популяцию
+    std::array<uint64_t, crossover_names.size()> crossover_applied{};
+    std::array<uint64_t, crossover_names.size()> crossover_accepted{};
+    /// процессорное время кроссовера вместе с доводкой потомка, в микросекундах
+    std::array<uint64_t, crossover_names.size()> crossover_cpu_us{};
+
+    /// обращения к кэшу оценок маршрутов и попадания, см. SetTourCache
+    uint64_t cache_lookups = 0;
+    uint64_t cache_hits = 0;
+    /// возмущения, отброшенные потому, что привели в уже найденный локальный оптимум
+    uint64_t perturbation_skips = 0;
+    /// ходы окрестностей, проверенные нижней оценкой, и отброшенные ей без полной оценки:
+    /// по score и по max_distance, см. SetMoveBounds
+    uint64_t move_bound_checks = 0;
+    uint64_t move_bound_score_skips = 0;
+    uint64_t move_bound_distance_skips = 0;
+    /// оценки ходов с досрочным выходом и прерванные из них: маршрут заведомо не улучшает
+    /// или нарушает max_distance
+    uint64_t limited_evaluations = 0;
+    uint64_t early_aborts = 0;
+
+    /// решения сохраненной популяции, с которых продолжен поиск после обновления задачи,
+    /// и выброшенные из них как ставшие недопустимыми, см. Solver::ApplySliceDelta
+    uint64_t resumed_solutions = 0;
+    uint64_t resume_dropped = 0;
+
+    /// итерации основного цикла генетического алгоритма
+    uint64_t ga_iterations = 0;
+    /// решения, отброшенные как дубликаты уже имеющихся в популяции
+    uint64_t dedup_rejections = 0;
+
+    void merge(const SearchStatistics &other);
+};
+
+inline SearchStatistics &LocalStatistics() {
+    static thread_local SearchStatistics statistics;
+    return statistics;
+}
+
+/// Процессорное время текущего потока в микросекундах
+inline uint64_t ThreadCpuTimeUs() {
+    timespec time{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000 + static_cast<uint64_t>(time.tv_nsec) / 1000;
+}
+
+/// Добавляет время жизни объекта (в микросекундах) к счетчику фазы
+class PhaseTimer {
+public:
+    explicit PhaseTimer(uint64_t &counter) : counter(counter), start(std::chrono::steady_clock::now()) {}
+
+    ~PhaseTimer() {
+        counter += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    uint64_t &counter;
+    std::chrono::steady_clock::time_point start;
+};
+
+/// Фаза поиска, в которой найдено улучшение
+enum class SearchPhase : uint8_t {
+    FirstStep = 0,
+    PopulationInit,
+    InitialVNS,
+    GeneticLoop,
+    Resume,
+};
+
+/// Запись трассы сходимости: новое лучшее решение потока
+struct IterInfo {
+    /// имена фаз в порядке SearchPhase
+    static constexpr std::array<const char *, 5> phase_names = {
+        "first_step", "population_init", "initial_vns", "genetic_loop", "resume"
+    };
+
+    int64_t distance;
+    int64_t score;
+    int64_t time;
+    /// микросекунды от запуска первого шага решателя
+    uint64_t timestamp_us;
+    /// номер потока (ответа первого шага), в котором найдено решение
+    uint32_t thread;
+    SearchPhase phase;
+};
+
+/// Итог одного потока второго шага (одного ответа первого шага)
+struct ThreadStatistics {
+    /// номер ответа первого шага
+    size_t answer = 0;
+    int64_t score = 0;
+    uint64_t elapsed_us = 0;
+    uint64_t path_evaluations = 0;
+    double evaluations_per_second = 0;
+    /// пройденные ступени отбора, выбыл ли поток на ступени, остановлен ли по верхней оценке, см. Race
+    uint32_t rungs = 0;
+    bool eliminated = false;
+    bool hopeless = false;
+};
+
+struct SolverStatistics {
+    /// seed решателя, с которым запуск можно повторить
+    uint64_t seed = 0;
+    /// количество наборов вершин, найденных первым шагом
+    size_t first_step_answers = 0;
+    /// наборы вершин, совпавшие с уже найденными, для них потоки не запускаются
+    size_t duplicate_answers = 0;
+    /// лучшее значение целевой функции после первого шага
+    int64_t first_step_score = 0;
+    /// время работы шагов в микросекундах
+    uint64_t first_step_us = 0;
+    uint64_t second_step_us = 0;
+    /// вызовы get_time_dependent_cost в первом шаге
+    uint64_t first_step_cost_evaluations = 0;
+    /// был ли теплый старт, score его маршрута после пересчета по задаче и выброшенные из маршрута
+    /// вершины, см. Solver::SetWarmStart
+    bool warm_start = false;
+    int64_t warm_start_score = 0;
+    size_t warm_start_dropped = 0;
+    /// примененные обновления срезов time_matrix, см. Solver::ApplySliceDelta
+    size_t slice_updates = 0;
+    /// сколько раз запуск продолжался с чекпоинта и сколько чекпоинтов записано, см. Solver::Resume
+    uint32_t checkpoint_generation = 0;
+    size_t checkpoints_written = 0;
+
+    /// счетчики второго шага, слитые по всем потокам
+    SearchStatistics search;
+    /// по потоку на каждый ответ первого шага, кроме повторов
+    std::vector<ThreadStatistics> threads;
+
+    /// колонки для csv в порядке get_data_to_csv
+    static std::string csv_header();
+
+    std::string get_data_to_csv() const;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/// Запись интервалов работы решателя (span) для просмотра в Perfetto / chrome://tracing.
+/// Каждый поток пишет в собственный буфер фиксированного размера без блокировок,
+/// при переполнении буфера новые интервалы отбрасываются и считаются.
+/// Пока запись не включена, TimelineSpan стоит одной загрузки атомарного флага.
+namespace Timeline {
+    inline std::atomic<bool> enabled{false};
+
+    /// включает запись, @events_per_thread - размер буфера одного потока
+    void Enable(size_t events_per_thread = 1 << 18);
+
+    inline bool IsEnabled() {
+        return enabled.load(std::memory_order_acquire);
+    }
+
+    /// @value < 0 - у интервала нет аргумента
+    void Record(const char *category, const char *name, int64_t value,
+                std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+    /// Пишет все записанные интервалы в формате Chrome trace JSON.
+    /// Можно вызывать во время записи: попадут интервалы, завершенные к моменту вызова.
+    bool WriteChromeTrace(const std::string &path);
+}
+
+/// Интервал от создания до разрушения объекта. @category и @name должны быть строковыми литералами.
+class TimelineSpan {
+public:
+    TimelineSpan(const char *category, const char *name, int64_t value = -1)
+            : category(category), name(name), value(value), active(Timeline::IsEnabled()) {
+        if (active) [[unlikely]] {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TimelineSpan() {
+        if (active) [[unlikely]] {
+            Timeline::Record(category, name, value, start, std::chrono::steady_clock::now());
+        }
+    }
+
+    TimelineSpan(const TimelineSpan &) = delete;
+    TimelineSpan &operator=(const TimelineSpan &) = delete;
+
+private:
+    const char *category;
+    const char *name;
+    int64_t value;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Ограниченный кэш оценок маршрутов одного потока: Zobrist-хэш маршрута (TourHash) -> (distance, time, score).
+/// Таблица наборно-ассоциативная, внутри набора вытеснение по CLOCK: запись с битом обращения
+/// получает второй шанс. Совпадение 64-битных хэшей разных маршрутов считается невозможным.
+class TourCache {
+public:
+    struct Entry {
+        uint64_t hash = 0;
+        int64_t distance = 0;
+        int64_t time = 0;
+        int64_t score = 0;
+        bool used = false;
+        bool referenced = false;
+        /// маршрут - результат VND, то есть локальный оптимум всех окрестностей
+        bool local_optimum = false;
+    };
+
+    /// пересоздает кэш не меньше чем на @capacity записей, 0 - кэш выключен
+    void reset(size_t capacity);
+
+    bool enabled() const {
+        return !entries.empty();
+    }
+
+    /// запись маршрута с хэшем @hash или nullptr
+    const Entry *find(uint64_t hash);
+
+    /// добавляет или обновляет запись, @local_optimum только выставляет флаг, но не снимает
+    void insert(uint64_t hash, int64_t distance, int64_t time, int64_t score, bool local_optimum = false);
+
+private:
+    /// записей в наборе
+    static constexpr size_t ways = 4;
+
+    std::vector<Entry> entries;
+    /// стрелка CLOCK каждого набора
+    std::vector<uint8_t> hands;
+    size_t set_mask = 0;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "path.hpp"
+#include "../utils/problem_arguments.hpp"
+
+#include <string>
+
+/// Проверки решений, не зависящие от кода поиска: эталон, с которым сравниваются
+/// быстрые и инкрементальные оценки маршрута.
+namespace Validation {
+    struct Metrics {
+        int64_t distance = 0;
+        int64_t time = 0;
+        int64_t score = 0;
+
+        bool operator==(const Metrics &other) const {
+            return distance == other.distance && time == other.time && score == other.score;
+        }
+
+        bool operator!=(const Metrics &other) const {
+            return !(*this == other);
+        }
+    };
+
+    /// Пересчет метрик маршрута напрямую по матрицам, без InputData::get_path_time_distance_score
+    /// и get_time_dependent_cost. Вершины маршрута должны быть в диапазоне задачи.
+    Metrics Evaluate(const InputData &input, const Path &tour);
+
+    /// Маршрут начинается и заканчивается в депо, вершины в диапазоне задачи и не повторяются.
+    /// Возвращает описание первой найденной ошибки или пустую строку.
+    std::string CheckTour(const InputData &input, const Path &tour);
+
+    /// @tour обходит те же вершины, что и @reference, возможно в другом порядке
+    std::string CheckSameVertices(const Path &tour, const Path &reference);
+
+    /// Ограничения задачи: загрузка, время и расстояние маршрута
+    std::string CheckConstraints(const InputData &input, const Path &tour, const Metrics &metrics);
+}
+
+std::ostream &operator<<(std::ostream &os, const Validation::Metrics &metrics);
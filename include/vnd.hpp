@@ -6,6 +6,8 @@
 #include <random>
 #include <algorithm>
 
+class BatchEvaluator;
+
 enum class OptimizationType: int {
     Shift = 1,
     SwapAdjacent,
@@ -14,6 +16,34 @@ enum class OptimizationType: int {
     OrOpt,
 };
 
+/// Один проход окрестности уровня @level (уровни больше OrOpt - OrOpt с большим размером сегмента),
+/// возвращает лучшего соседа или исходное решение, если улучшить не удалось
+Solution ApplyNeighbourhood(int level, const Solution &solution, const InputData &inputData);
+
+/// Пересоздает генератор случайных чисел окрестностей текущего потока
+void SeedNeighbourhoods(uint64_t seed);
+
+/// Адаптивный выбор окрестностей в текущем потоке (в духе ALNS): для каждого уровня копится
+/// скользящее среднее прироста score на миллисекунду процессорного времени прохода.
+/// VND обходит уровни по убыванию этой оценки и после улучшения начинает с лучшего из них,
+/// Perturbation выбирает уровень рулеткой по оценкам. Вызов сбрасывает накопленные оценки.
+void SetAdaptiveNeighbourhoods(bool enabled);
+
+/// Кэш оценок маршрутов текущего потока на @capacity записей (0 - выключен, по умолчанию), см. TourCache.
+/// Окрестности берут оценку соседа из кэша по Zobrist-хэшу, который пересчитывается только по
+/// позициям, затронутым ходом. Результаты VND запоминаются как локальные оптимумы, и Perturbation
+/// пропускает возмущения, которые в них приводят. Вызов очищает кэш.
+void SetTourCache(size_t capacity);
+
+/// Пакетная оценка возмущений текущего потока (nullptr - выключена, по умолчанию): Perturbation строит
+/// сразу несколько мостов и оценивает их одним вызовом @evaluator, построенного по той же задаче.
+void SetBatchEvaluator(BatchEvaluator *evaluator);
+
+/// Отсев ходов окрестностей текущего потока по нижней оценке для задачи @input (nullptr - выключен,
+/// по умолчанию): ход не оценивается полностью, если по минимумам времени перехода по срезам и точному
+/// расстоянию он заведомо не улучшает score или нарушает max_distance. Выбор ходов не меняется.
+void SetMoveBounds(const InputData *input);
+
 Solution VND(Solution solution, int kMax, const InputData &inputData);
 
 Solution Perturbation(const Solution& solution, int level, double p, const InputData& inputData);
\ No newline at end of file
@@ -1,129 +1,152 @@
 #include "utils/json_parser.hpp"
+#include "utils/binary_parser.hpp"
 
-#include "include/first_step.hpp"
-#include "include/algorithm.hpp"
+#include "include/solver.hpp"
+#include "include/cancellation.hpp"
+#include "include/daemon.hpp"
+#include "include/timeline.hpp"
 
-#ifdef DEBUG
-#include "utils/debug.h"
-#endif
-
-#include <iostream>
-#include <fstream>
-#include <thread>
-#include <vector>
 #include <algorithm>
-#include <optional>
-
-using points_type = FirstStepAnswer::points_type;
+#include <filesystem>
+#include <fstream>
+#include <iostream>
 
-Solution Optimize(const FirstStepAnswer& firstStepAnswer, InputData& input, const ProgramArguments& args) {
+namespace {
+    bool WriteTraceToCsvFile(const std::string &path, const std::vector<IterInfo> &trace) {
+        std::ofstream csv(path);
+        if (!csv) {
+            std::cerr << "Can`t open trace file to write" << std::endl;
+            return false;
+        }
 
-    // новый маршрут будет иметь вид 0 -> 1 -> 2 -> ... -> n -> 0
-    std::vector<points_type> tour(firstStepAnswer.vertexes.size());
-    // отображение из новых вершин в старые индексы
-    std::map<points_type, points_type> from_new_to_old;
-    tour[0] = 0;
-    from_new_to_old[0] = 0;
-    for (size_t i = 1; i < firstStepAnswer.vertexes.size() - 1; ++i) {
-        from_new_to_old[i] = firstStepAnswer.vertexes[i];
-        tour[i] = i;
+        csv << "timestamp_us,thread,phase,score,time,distance\n";
+        for (const auto &info: trace) {
+            csv << info.timestamp_us << "," << info.thread << "," << IterInfo::phase_names[static_cast<size_t>(info.phase)]
+                << "," << info.score << "," << info.time << "," << info.distance << "\n";
+        }
+        return true;
     }
-    tour[firstStepAnswer.vertexes.size() - 1] = 0;
-
-    input.from_new_to_old = std::move(from_new_to_old);
-    input.is_mapped = true;
-    
-    Solution solution(std::move(tour), firstStepAnswer.distance, firstStepAnswer.time, firstStepAnswer.value);
 
-    auto ctx = Context {
-        .args = args
-    };
-
-    auto answer = applyTspTDPDP(std::move(solution), input, ctx);
-    
-    for (size_t i = 0; i < answer.tour.size(); ++i) {
-        answer.tour[i] = input.from_new_to_old[answer.tour[i]];
+    /// Выдача нового лучшего решения: строка JSONL в stdout для "-", иначе атомарная замена файла решения.
+    /// В обоих случаях к решению добавляется время от запуска в микросекундах.
+    void StreamIncumbent(const std::string &target, const Solution &solution, uint64_t elapsed_us) {
+        auto extra = nlohmann::json{{"elapsed_us", elapsed_us}};
+        if (target == "-") {
+            auto line = JsonParser::SolutionToJson(solution);
+            line.update(extra);
+            std::cout << line.dump() << std::endl;
+            return;
+        }
+        JsonParser::ReplaceSolutionJsonFile(target, solution, extra);
     }
-
-    return answer;
 }
 
-Solution Solve(InputData &&input, const ProgramArguments& args) {
-
-    std::vector<FirstStepAnswer> firstStepAnswers;
-
-    // нужно чтобы нам bitset был хоть сколько-то гибким
-    if (input.points_count < 128) {
-        firstStepAnswers = DoFirstStep<128, true>(input);
-    } else if (input.points_count < 256) {
-        firstStepAnswers = DoFirstStep<256, true>(input);
-    } else if (input.points_count < 512) {
-        firstStepAnswers = DoFirstStep<512, true>(input);
-    } else {
-        firstStepAnswers = DoFirstStep<std::numeric_limits<InputData::points_type>::max(), true>(input);
+int main(int argc, char *argv[]) {
+    ProgramArguments args;
+    if (!ParseProgramArguments(argc, argv, args)) {
+        return -1;
     }
-    
-    // сохраняем копию input для использования в потоках
-    const InputData input_copy = std::move(input);
 
-    if (firstStepAnswers.empty()) {
-        return {0};
+    if (!args.timeline_file.empty()) {
+        Timeline::Enable();
     }
 
-    std::vector<std::optional<Solution>> solutions(firstStepAnswers.size());
-    std::vector<std::thread> threads;
-    threads.reserve(firstStepAnswers.size());
+    if (!args.daemon_socket.empty()) {
+        auto code = RunDaemon(args);
+        if (!args.timeline_file.empty() && !Timeline::WriteChromeTrace(args.timeline_file)) {
+            return -3;
+        }
+        return code;
+    }
 
-    for (size_t i = 0; i < firstStepAnswers.size(); ++i) {
-        threads.emplace_back([&input_copy, &args, &firstStepAnswers, &solutions, i]() {
-            // вынуждены создавать копию тк строим отображение mapped (наверное можно выпилить костыль)
-            InputData thread_input = input_copy;
-            
-            Solution solution = Optimize(firstStepAnswers[i], thread_input, args);
-            
-            solutions[i] = std::move(solution);
-        });
+    // по сигналу, файлу-флагу или "stop" в stdin поиск сворачивается, и ниже пишется лучшее найденное
+    Cancellation::InstallSignalHandlers();
+    if (!args.stop_file.empty()) {
+        Cancellation::WatchStopFile(args.stop_file);
+    }
+    if (args.stop_stdin) {
+        Cancellation::WatchStdin();
     }
 
-    for (auto& thread : threads) {
-        thread.join();
+    InputData input;
+    bool parsed = BinaryParser::IsBinaryPath(args.problemJsonPath)
+                  ? BinaryParser::ParseInputDataFromBinary(args.problemJsonPath, input)
+                  : JsonParser::ParseInputDataFromJson(args.problemJsonPath, input);
+    if (!parsed) {
+        return -2;
     }
 
-    std::optional<size_t> best_index;
-    for (size_t i = 0; i < solutions.size(); ++i) {
-        if (solutions[i].has_value()) {
-            if (!best_index.has_value() || solutions[i]->score > solutions[*best_index]->score) {
-                best_index = i;
-            }
+    Solver solver(input, args.meta);
+    solver.EnableTrace(args.save_trace || !args.trace_file.empty());
+    if (args.seed.has_value()) {
+        solver.SetSeed(*args.seed);
+    }
+    if (!args.warm_start_file.empty()) {
+        OutData previous;
+        if (!JsonParser::ParseSolutionFromJson(args.warm_start_file, previous) ||
+            !solver.SetWarmStart({.route = std::move(previous.route), .neighbours = args.warm_start_neighbours})) {
+            return -2;
         }
     }
-
-    if (!best_index.has_value()) {
-        return {0};
+    if (!args.checkpoint_file.empty()) {
+        solver.EnableCheckpoints(args.checkpoint_file, std::chrono::seconds(args.checkpoint_interval));
+    }
+    if (args.resume) {
+        if (args.checkpoint_file.empty()) {
+            std::cerr << "--resume needs --checkpoint" << std::endl;
+            return -1;
+        }
+        // первый запуск с --resume еще не успел записать чекпоинт: начинаем с нуля
+        if (std::filesystem::exists(args.checkpoint_file) && !solver.Resume(args.checkpoint_file)) {
+            return -2;
+        }
     }
+    if (!args.stream_target.empty()) {
+        solver.SetIncumbentCallback([&target = args.stream_target](const Solution &solution, uint64_t elapsed_us) {
+            StreamIncumbent(target, solution, elapsed_us);
+        });
+    }
+    // время -t отводится только на второй шаг, при продолжении - без уже потраченного прерванным запуском
+    solver.FirstStep();
+    const auto budget = std::chrono::microseconds(args.time * 1000000) -
+                        std::chrono::microseconds(std::min(solver.ResumedElapsedUs(), args.time * 1000000));
+    auto result = solver.Solve(Solver::Clock::now() + budget);
 
-    if (args.save_csv) [[unlikely]] {
+    if (args.save_csv && !result.solution.tour.empty()) [[unlikely]] {
         std::ofstream csv(args.csv_file, std::ios::app);
-        csv << args.problemJsonPath << "," << solutions[*best_index]->get_data_to_csv() << "\n";
+        if (args.save_stats) {
+            // заголовок пишется только в новый файл, чтобы колонки статистики можно было разобрать
+            if (csv.tellp() == 0) {
+                csv << "file_name,score,time,distance," << SolverStatistics::csv_header() << "\n";
+            }
+            csv << args.problemJsonPath << "," << result.solution.get_data_to_csv() << ","
+                << result.statistics.get_data_to_csv() << "\n";
+        } else {
+            csv << args.problemJsonPath << "," << result.solution.get_data_to_csv() << "\n";
+        }
     }
 
-    return *solutions[*best_index];
-}
-
-int main(int argc, char *argv[]) {
-    ProgramArguments args;
-    if (!ParseProgramArguments(argc, argv, args)) {
-        return -1;
+    if (!args.trace_file.empty() && !WriteTraceToCsvFile(args.trace_file, result.trace)) {
+        return -3;
     }
 
-    InputData input;
-    if (!JsonParser::ParseInputDataFromJson(args.problemJsonPath, input)) {
-        return -2;
+    if (!args.timeline_file.empty() && !Timeline::WriteChromeTrace(args.timeline_file)) {
+        return -3;
     }
 
-    if (!JsonParser::WriteSolutionTojsonFile(args.solutionJsonPath, Solve(std::move(input), args))) {
+    auto extra = nlohmann::json::object();
+    if (args.save_stats) {
+        extra["stats"] = JsonParser::StatisticsToJson(result.statistics);
+    }
+    if (args.save_trace) {
+        extra["trace"] = JsonParser::TraceToJson(result.trace);
+    }
+    // файл, в который выдавались решения, мог уже читать диспетчер: итог заменяет его атомарно
+    const bool replace = !args.stream_target.empty() && args.stream_target == args.solutionJsonPath;
+    if (replace ? !JsonParser::ReplaceSolutionJsonFile(args.solutionJsonPath, result.solution, extra)
+                : !JsonParser::WriteSolutionTojsonFile(args.solutionJsonPath, std::move(result.solution), extra)) {
         return -3;
     }
 
     return 0;
-}
\ No newline at end of file
+}
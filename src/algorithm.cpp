@@ -2,110 +2,217 @@
 
 #include "../include/init_population.hpp"
 #include "../include/vns.hpp"
+#include "../include/vnd.hpp"
 #include "../include/crossover.hpp"
+#include "../include/timeline.hpp"
+#include "../include/batch_evaluator.hpp"
+#include "../include/race.hpp"
+#include "../include/checkpoint.hpp"
+#include "../include/cancellation.hpp"
+
+#include "../utils/random.hpp"
 
 #include <random>
 #include <algorithm>
 #include <chrono>
+#include <optional>
 
 #ifdef DEBUG
 #include "../utils/debug.h"
 #endif
 
 namespace {
-    bool is_time_limit(decltype(std::chrono::steady_clock::now()) start, uint64_t max_time) {
-        auto current = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            current - start
-        ).count();
-
-        return elapsed > max_time;
+    // дедлайн или запрошенная остановка (сигнал, файл-флаг, stdin)
+    bool is_time_limit(std::chrono::steady_clock::time_point deadline) {
+        return Cancellation::Requested() || std::chrono::steady_clock::now() > deadline;
     }
 
-#ifdef SAVE_STEPS
-    uint64_t get_elapsed_seconds(decltype(std::chrono::steady_clock::now()) start) {
-        auto current = std::chrono::steady_clock::now();
-        return std::chrono::duration_cast<std::chrono::seconds>(
-            current - start
-        ).count();
-    }
+    /// пакетная оценка потока на время поиска: Perturbation видит ее, пока объект жив
+    struct BatchEvaluationScope {
+        std::optional<BatchEvaluator> evaluator;
+
+        BatchEvaluationScope(bool enabled, const InputData &inputData) {
+            if (enabled) {
+                evaluator.emplace(inputData);
+            }
+            SetBatchEvaluator(get());
+        }
+
+        ~BatchEvaluationScope() {
+            SetBatchEvaluator(nullptr);
+        }
 
-    void log_best_solution_if_needed(
-        decltype(std::chrono::steady_clock::now()) start,
-        const Solution& best_solution,
-        Context& ctx,
-        uint64_t& last_logged_time
-    ) {
-        uint64_t elapsed = get_elapsed_seconds(start);
-
-        if (elapsed >= last_logged_time + 5) {
-
-            last_logged_time = (elapsed / 5) * 5;
-                        
-            ctx.time_iterations.push_back(
-                {
-                    .distance = best_solution.distance,
-                    .score = static_cast<uint32_t>(best_solution.score),
-                    .time = best_solution.time,
-                    .timestamp = last_logged_time
+        BatchEvaluator *get() {
+            return evaluator ? &*evaluator : nullptr;
+        }
+    };
+
+    /// упорядоченные пары из @count лучших кандидатов в начале @population для пакетного кроссовера,
+    /// не больше лент BatchEvaluator
+    void ParentPairs(const std::vector<Solution> &population, size_t count,
+                     std::vector<std::pair<const Solution *, const Solution *>> &pairs) {
+        pairs.clear();
+        if (count < 2) {
+            pairs.emplace_back(&population[0], &population[0]);
+            return;
+        }
+        for (size_t first = 0; first < count; ++first) {
+            for (size_t second = 0; second < count && pairs.size() < BatchEvaluator::max_lanes; ++second) {
+                if (first != second) {
+                    pairs.emplace_back(&population[first], &population[second]);
                 }
-            );
+            }
         }
     }
-#endif
+
+    // отсев ходов по нижней оценке на время работы потока
+    struct MoveBoundsScope {
+        MoveBoundsScope(bool enabled, const InputData &inputData) {
+            SetMoveBounds(enabled ? &inputData : nullptr);
+        }
+
+        ~MoveBoundsScope() {
+            SetMoveBounds(nullptr);
+        }
+    };
+
+    // допустимое решение лучше всех найденных в этом потоке предлагается общему лучшему
+    // и пишется в трассу
+    void trace_if_improved(Context& ctx, const Solution& solution, const InputData& inputData, SearchPhase phase) {
+        if (solution.time > inputData.max_time || solution.distance > inputData.max_distance) {
+            return;
+        }
+        if (solution.score <= ctx.best_score) {
+            return;
+        }
+        ctx.best_score = solution.score;
+        if (ctx.race != nullptr && ctx.race->offer(solution.score) && ctx.on_incumbent) {
+            ctx.on_incumbent(solution);
+        }
+        if (!ctx.trace) [[likely]] {
+            return;
+        }
+
+        ctx.time_iterations.push_back(
+            {
+                .distance = solution.distance,
+                .score = solution.score,
+                .time = solution.time,
+                .timestamp_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - ctx.trace_start).count()),
+                .thread = ctx.thread,
+                .phase = phase
+            }
+        );
+    }
 }
 
 Solution applyTspTDPDP(Solution&& solution, const InputData &inputData, Context& ctx) {
 
-    auto start = std::chrono::steady_clock::now();
-    const auto& params = ctx.args.meta;
-    auto max_time = ctx.args.time;
-#ifdef SAVE_STEPS
-    uint64_t last_logged_time = 0;
-#endif
+    const auto& params = ctx.params;
+    auto& statistics = LocalStatistics();
 
-    auto populationInitializer = PopulationInitializer();
-    auto crossover = Crossover();
+    SeedNeighbourhoods(Random::StreamSeed(ctx.seed, Random::Stream::Neighbourhood));
+    SetAdaptiveNeighbourhoods(params.adaptive_neighbourhoods);
+    SetTourCache(params.tour_cache_size);
+    BatchEvaluationScope batch_evaluation(params.batch_evaluation, inputData);
+    MoveBoundsScope move_bounds(params.move_bounds, inputData);
+    // маршрут проходит все точки подзадачи, поэтому score потока не больше этой оценки
+    const auto upper_bound = ctx.race != nullptr ? ScoreUpperBound(inputData) : 0;
+    auto hopeless = [&ctx, upper_bound]() {
+        return ctx.race != nullptr && ctx.race->hopeless(ctx.thread, upper_bound);
+    };
+    auto populationInitializer = PopulationInitializer(Random::StreamSeed(ctx.seed, Random::Stream::PopulationInit));
+    auto crossover = Crossover(Random::StreamSeed(ctx.seed, Random::Stream::Crossover));
 
     auto path_size = solution.tour.size();
 
     std::vector<Solution> population;
     population.reserve(params.population_size);
-    population.emplace_back(std::move(solution));
-    populationInitializer.initialize_population(population[0].tour.size(),
-                                                params.population_size,
-                                                params.beta,
-                                                params.alpha,
-                                                inputData,
-                                                population);
-#ifdef SAVE_STEPS
-    std::sort(population.begin(), population.end(), 
-              [](const auto &sol1, const auto &sol2) { return sol1.score > sol2.score; });
-    log_best_solution_if_needed(start, population[0], ctx, last_logged_time);
-#endif
+    // решения сохраненной популяции в начале population: начальный VNS нужен только лучшему из них
+    size_t resumed = 0;
+    if (ctx.population != nullptr && !ctx.population->empty()) {
+        // задача могла измениться: популяция переоценивается, ставшие недопустимыми решения уходят
+        for (auto& member: *ctx.population) {
+            auto [distance, time, score] = inputData.get_path_time_distance_score(member.tour);
+            if (time > inputData.max_time || distance > inputData.max_distance) {
+                ++statistics.resume_dropped;
+                continue;
+            }
+            member.distance = distance, member.time = time, member.score = score;
+            population.emplace_back(std::move(member));
+        }
+        ctx.population->clear();
+        std::sort(population.begin(), population.end(),
+                  [](const auto &sol1, const auto &sol2) { return sol1.score > sol2.score; });
+        resumed = population.size();
+        statistics.resumed_solutions += resumed;
+        for (const auto& member: population) {
+            trace_if_improved(ctx, member, inputData, SearchPhase::Resume);
+        }
+    }
+    if (population.empty()) {
+        population.emplace_back(std::move(solution));
+        trace_if_improved(ctx, population[0], inputData, SearchPhase::FirstStep);
+    }
+    if (ctx.warm_start && resumed == 0) {
+        // прошлый маршрут уже близок к хорошему: рядом с ним ищем плотнее, остальное строится как обычно
+        TimelineSpan span("search", "WarmStart");
+        const auto variants = static_cast<size_t>(params.population_size) / 2;
+        for (size_t attempt = 0; attempt < 2 * variants && population.size() <= variants; ++attempt) {
+            auto variant = Perturbation(population[0], params.kMax, 1.0, inputData);
+            if (variant.time <= inputData.max_time && variant.distance <= inputData.max_distance &&
+                std::find(population.begin(), population.end(), variant) == population.end()) {
+                population.emplace_back(std::move(variant));
+            }
+        }
+    }
+    {
+        PhaseTimer timer(statistics.population_init_us);
+        TimelineSpan span("search", "PopulationInit");
+        populationInitializer.initialize_population(population[0].tour.size(),
+                                                    params.population_size,
+                                                    params.beta,
+                                                    params.alpha,
+                                                    inputData,
+                                                    population,
+                                                    params.init_threads,
+                                                    batch_evaluation.get());
+    }
+    for (const auto& member: population) {
+        trace_if_improved(ctx, member, inputData, SearchPhase::PopulationInit);
+    }
 
-    for (size_t i = 0; i < population.size(); ++i) {
-        // проверка что выписываемся в ограничения по времени
-        if (is_time_limit(start, max_time)) [[unlikely]] {
-            std::sort(population.begin(), population.end(), 
-              [](const auto &sol1, const auto &sol2) { return sol1.score > sol2.score; });
-              
-            return population[0];
-        }
-#ifdef SAVE_STEPS
-    std::sort(population.begin(), population.begin() + i, 
-              [](const auto &sol1, const auto &sol2) { return sol1.score > sol2.score; });
-    log_best_solution_if_needed(start, population[0], ctx, last_logged_time);
-#endif
+    // лучшее решение потока, популяция сохраняется для следующего вызова
+    auto finish = [&ctx, &population]() {
+        std::sort(population.begin(), population.end(),
+                  [](const auto &sol1, const auto &sol2) { return sol1.score > sol2.score; });
+        if (ctx.population != nullptr) {
+            *ctx.population = population;
+        }
+        if (ctx.checkpoint != nullptr) {
+            ctx.checkpoint->publish(ctx.thread, population);
+        }
+        return population[0];
+    };
 
-        population[i] = VNS(population[i], inputData, params.nloop, params.kMax, params.p);
+    {
+        PhaseTimer timer(statistics.initial_vns_us);
+        for (size_t i = 0; i < population.size(); ++i) {
+            // проверка что выписываемся в ограничения по времени и что другой поток не нашел
+            // решение лучше всех возможных в этом
+            if (is_time_limit(ctx.deadline) || hopeless()) [[unlikely]] {
+                return finish();
+            }
+            // остальные сохраненные решения доводит GA, VNS всей популяции заново не нужен
+            if (i > 0 && i < resumed) {
+                continue;
+            }
+
+            population[i] = VNS(population[i], inputData, params.nloop, params.kMax, params.p);
+            trace_if_improved(ctx, population[i], inputData, SearchPhase::InitialVNS);
+        }
     }
-    
-#ifdef SAVE_STEPS
-    std::sort(population.begin(), population.end(), 
-              [](const auto &sol1, const auto &sol2) { return sol1.score > sol2.score; });
-    log_best_solution_if_needed(start, population[0], ctx, last_logged_time);
-#endif
 
     // удаляем повторы после оптимизации чтобы на вход кроссовера не шли два одинаковых пути
     // и мы не получали тот же после него
@@ -114,6 +221,8 @@ Solution applyTspTDPDP(Solution&& solution, const InputData &inputData, Context&
     for (auto& solution: population) {
         if (std::find(seen.begin(), seen.end(), solution) == seen.end()) {
             seen.emplace_back(std::move(solution));
+        } else {
+            ++statistics.dedup_rejections;
         }
     }
     population = std::move(seen);
@@ -123,22 +232,33 @@ Solution applyTspTDPDP(Solution&& solution, const InputData &inputData, Context&
 #endif
 
     uint64_t iters = 0;
-    std::mt19937 rng;
+    Random::Generator rng(Random::StreamSeed(ctx.seed, Random::Stream::GeneticLoop));
     auto candidates_size = std::min(population.size(), params.max_crossover_candidates);
     int iter_without_solution = 0;
+    // с пакетной оценкой итерация строит потомков всех пар кандидатов, а VNS доводит только лучшего
+    std::vector<std::pair<const Solution *, const Solution *>> parents;
+    PhaseTimer ga_timer(statistics.ga_loop_us);
 
-    while (iter_without_solution < params.max_iter_without_solution) {
+    // при отборе потоков выжившим на ступенях разрешается больше итераций без улучшения
+    auto patience = [&ctx, &params]() {
+        return params.max_iter_without_solution * (ctx.race != nullptr ? ctx.race->patience(ctx.thread) : 1);
+    };
 
-#ifdef SAVE_STEPS
-        std::sort(population.begin(), population.end(), 
-              [](const auto &sol1, const auto &sol2) { return sol1.score > sol2.score; });
-        log_best_solution_if_needed(start, population[0], ctx, last_logged_time);
-#endif
+    while (iter_without_solution < patience()) {
+        ++statistics.ga_iterations;
 
         // проверка что выписываемся в ограничения по времени
-        if (is_time_limit(start, max_time)) [[unlikely]] {
+        if (is_time_limit(ctx.deadline) || hopeless()) [[unlikely]] {
+            break;
+        }
+        // ступень отбора: слабые потоки выбывают и отдают процессор остальным
+        if (ctx.race != nullptr && !ctx.race->advance(ctx.thread, iters, ctx.best_score, ctx.deadline)) {
             break;
         }
+        ++iters;
+        if (ctx.checkpoint != nullptr && ctx.checkpoint->due(ctx.thread)) [[unlikely]] {
+            ctx.checkpoint->publish(ctx.thread, population);
+        }
 
         // среди случайных candidates_size туров выбираем два лучших
         std::shuffle(population.begin(), population.end(), rng);
@@ -148,7 +268,12 @@ Solution applyTspTDPDP(Solution&& solution, const InputData &inputData, Context&
         const auto &TC = population[0];
         const auto &TP = population.size() > 1 ? population[1] : population[0];
 
-        auto crossoverSolution = crossover.crossover(TC, TP, inputData);
+        if (batch_evaluation.get() != nullptr) {
+            ParentPairs(population, candidates_size, parents);
+        }
+        auto crossoverSolution = batch_evaluation.get() != nullptr
+                ? crossover.crossover(parents, inputData, *batch_evaluation.get())
+                : crossover.crossover(TC, TP, inputData);
         crossoverSolution = VNS(crossoverSolution, inputData, params.nloop, params.kMax, params.p);
 
         if (crossoverSolution.time > inputData.max_time || crossoverSolution.distance > inputData.max_distance) {
@@ -157,6 +282,7 @@ Solution applyTspTDPDP(Solution&& solution, const InputData &inputData, Context&
                       << crossoverSolution.time << " vs input max_time: " << inputData.max_time << " "
                       << crossoverSolution.distance << " vs input max_distance "  << inputData.max_distance << std::endl;
 #endif
+            crossover.report(0);
             ++iter_without_solution;
             continue;
         }
@@ -166,23 +292,33 @@ Solution applyTspTDPDP(Solution&& solution, const InputData &inputData, Context&
 #ifdef DEBUG
             std::cout << "This solution in population, skip:\n" << crossoverSolution << std::endl;
 #endif
+            ++statistics.dedup_rejections;
+            crossover.report(0);
             ++iter_without_solution;
             continue;
         }
 
+        trace_if_improved(ctx, crossoverSolution, inputData, SearchPhase::GeneticLoop);
+
         std::sort(population.begin(), population.end(),
                     [](const auto &sol1, const auto &sol2) { return sol1.score > sol2.score; });
 
+        const bool improved_best = crossoverSolution.score > population[0].score;
+
         // если решение лучше текущего худшего, то заменяем его
         if (crossoverSolution.score > population[population.size() - 1].score) {
 #ifdef DEBUG
             std::cout << "Created new solution:\n" << crossoverSolution << std::endl;
 #endif
             population[population.size() - 1] = std::move(crossoverSolution);
+            ++statistics.crossover_accepted[static_cast<size_t>(crossover.last_type())];
+            crossover.report(improved_best ? 2 : 1);
+        } else {
+            crossover.report(0);
         }
 
         // в случае если не улучшили лучшее решение
-        if (crossoverSolution.score > population[0].score) {
+        if (improved_best) {
             iter_without_solution = 0;
 #ifdef DEBUG
             std::cout << "Updated best solution\n";
@@ -195,8 +331,5 @@ Solution applyTspTDPDP(Solution&& solution, const InputData &inputData, Context&
         }
     }
 
-    std::sort(population.begin(), population.end(), 
-              [](const auto &sol1, const auto &sol2) { return sol1.score > sol2.score; });
-            
-    return population[0];
+    return finish();
 }
\ No newline at end of file
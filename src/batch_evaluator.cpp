@@ -0,0 +1,337 @@
+#include "../include/batch_evaluator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_EVALUATOR_X86 1
+#endif
+
+namespace {
+    /// матрицы пакетной оценки, общие для всех наборов инструкций
+    struct Layout {
+        const double *time;
+        const double *distance;
+        const double *service;
+        const double *score;
+        int32_t points;
+        int32_t slices;
+    };
+
+    /// результат ленты: расстояние, время и важность маршрута
+    struct LaneResult {
+        double distance;
+        double time;
+        double score;
+    };
+
+#ifdef BATCH_EVALUATOR_X86
+    /// Оценка 8 маршрутов длины @length, вершины i-го шага - @vertices[i * stride .. + 8).
+    /// Две четверки лент считаются независимо, чтобы gather-ы одной перекрывали вычисления другой.
+    __attribute__((target("avx2")))
+    void EvaluateAvx2(const Layout &layout, const int32_t *vertices, size_t stride, size_t length,
+                      LaneResult *results) {
+        const auto duration = _mm256_set1_pd(static_cast<double>(InputData::time_duration));
+        const auto last_slice = _mm256_set1_pd(static_cast<double>(layout.slices - 1));
+        const auto last_index = _mm_set1_epi32(layout.slices - 1);
+        const auto points = _mm_set1_epi32(layout.points);
+        const auto matrix = _mm_set1_epi32(layout.points * layout.points);
+        const auto one = _mm_set1_epi32(1);
+        const auto zero = _mm256_setzero_pd();
+
+        __m256d time[2] = {zero, zero};
+        __m256d distance[2] = {zero, zero};
+        __m256d score[2] = {zero, zero};
+
+        for (size_t i = 0; i + 1 < length; ++i) {
+            for (int half = 0; half < 2; ++half) {
+                const auto from = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vertices + i * stride + half * 4));
+                const auto to = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vertices + (i + 1) * stride + half * 4));
+                const auto pair = _mm_add_epi32(_mm_mullo_epi32(from, points), to);
+
+                // срез времени отправления, после последнего среза берется последний без интерполяции
+                auto slice = _mm256_floor_pd(_mm256_div_pd(time[half], duration));
+                const auto after_last = _mm256_cmp_pd(slice, last_slice, _CMP_GE_OQ);
+                slice = _mm256_min_pd(slice, last_slice);
+                const auto offset = _mm256_blendv_pd(_mm256_sub_pd(time[half], _mm256_mul_pd(slice, duration)),
+                                                     zero, after_last);
+
+                const auto slice_index = _mm256_cvtpd_epi32(slice);
+                const auto next_index = _mm_min_epi32(_mm_add_epi32(slice_index, one), last_index);
+                const auto current = _mm256_i32gather_pd(layout.time,
+                                                         _mm_add_epi32(_mm_mullo_epi32(slice_index, matrix), pair), 8);
+                const auto next = _mm256_i32gather_pd(layout.time,
+                                                      _mm_add_epi32(_mm_mullo_epi32(next_index, matrix), pair), 8);
+                const auto numerator = _mm256_add_pd(_mm256_mul_pd(current, _mm256_sub_pd(duration, offset)),
+                                                     _mm256_mul_pd(next, offset));
+                const auto travel = _mm256_floor_pd(_mm256_div_pd(numerator, duration));
+
+                distance[half] = _mm256_add_pd(distance[half], _mm256_i32gather_pd(layout.distance, pair, 8));
+                time[half] = _mm256_add_pd(time[half],
+                                           _mm256_add_pd(_mm256_i32gather_pd(layout.service, to, 8), travel));
+                score[half] = _mm256_add_pd(score[half],
+                                            _mm256_sub_pd(_mm256_i32gather_pd(layout.score, to, 8), travel));
+            }
+        }
+
+        alignas(32) double lanes[3][8];
+        for (int half = 0; half < 2; ++half) {
+            _mm256_store_pd(lanes[0] + half * 4, distance[half]);
+            _mm256_store_pd(lanes[1] + half * 4, time[half]);
+            _mm256_store_pd(lanes[2] + half * 4, score[half]);
+        }
+        for (int lane = 0; lane < 8; ++lane) {
+            results[lane] = {lanes[0][lane], lanes[1][lane], lanes[2][lane]};
+        }
+    }
+
+    /// то же для 16 маршрутов в двух регистрах по 8 лент
+    __attribute__((target("avx512f")))
+    void EvaluateAvx512(const Layout &layout, const int32_t *vertices, size_t stride, size_t length,
+                        LaneResult *results) {
+        const auto duration = _mm512_set1_pd(static_cast<double>(InputData::time_duration));
+        const auto last_slice = _mm512_set1_pd(static_cast<double>(layout.slices - 1));
+        const auto last_index = _mm256_set1_epi32(layout.slices - 1);
+        const auto points = _mm256_set1_epi32(layout.points);
+        const auto matrix = _mm256_set1_epi32(layout.points * layout.points);
+        const auto one = _mm256_set1_epi32(1);
+        const auto zero = _mm512_setzero_pd();
+
+        __m512d time[2] = {zero, zero};
+        __m512d distance[2] = {zero, zero};
+        __m512d score[2] = {zero, zero};
+
+        for (size_t i = 0; i + 1 < length; ++i) {
+            for (int half = 0; half < 2; ++half) {
+                const auto from = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(vertices + i * stride + half * 8));
+                const auto to = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(vertices + (i + 1) * stride + half * 8));
+                const auto pair = _mm256_add_epi32(_mm256_mullo_epi32(from, points), to);
+
+                auto slice = _mm512_roundscale_pd(_mm512_div_pd(time[half], duration), _MM_FROUND_TO_NEG_INF);
+                const auto after_last = _mm512_cmp_pd_mask(slice, last_slice, _CMP_GE_OQ);
+                slice = _mm512_min_pd(slice, last_slice);
+                const auto offset = _mm512_mask_blend_pd(after_last,
+                                                         _mm512_sub_pd(time[half], _mm512_mul_pd(slice, duration)),
+                                                         zero);
+
+                const auto slice_index = _mm512_cvtpd_epi32(slice);
+                const auto next_index = _mm256_min_epi32(_mm256_add_epi32(slice_index, one), last_index);
+                const auto current = _mm512_i32gather_pd(
+                        _mm256_add_epi32(_mm256_mullo_epi32(slice_index, matrix), pair), layout.time, 8);
+                const auto next = _mm512_i32gather_pd(
+                        _mm256_add_epi32(_mm256_mullo_epi32(next_index, matrix), pair), layout.time, 8);
+                const auto numerator = _mm512_add_pd(_mm512_mul_pd(current, _mm512_sub_pd(duration, offset)),
+                                                     _mm512_mul_pd(next, offset));
+                const auto travel = _mm512_roundscale_pd(_mm512_div_pd(numerator, duration), _MM_FROUND_TO_NEG_INF);
+
+                distance[half] = _mm512_add_pd(distance[half], _mm512_i32gather_pd(pair, layout.distance, 8));
+                time[half] = _mm512_add_pd(time[half],
+                                           _mm512_add_pd(_mm512_i32gather_pd(to, layout.service, 8), travel));
+                score[half] = _mm512_add_pd(score[half],
+                                            _mm512_sub_pd(_mm512_i32gather_pd(to, layout.score, 8), travel));
+            }
+        }
+
+        alignas(64) double lanes[3][16];
+        for (int half = 0; half < 2; ++half) {
+            _mm512_store_pd(lanes[0] + half * 8, distance[half]);
+            _mm512_store_pd(lanes[1] + half * 8, time[half]);
+            _mm512_store_pd(lanes[2] + half * 8, score[half]);
+        }
+        for (int lane = 0; lane < 16; ++lane) {
+            results[lane] = {lanes[0][lane], lanes[1][lane], lanes[2][lane]};
+        }
+    }
+#endif
+
+    size_t Lanes(BatchEvaluator::Backend backend) {
+        switch (backend) {
+            case BatchEvaluator::Backend::AVX512:
+                return 16;
+            case BatchEvaluator::Backend::AVX2:
+                return 8;
+            default:
+                return 1;
+        }
+    }
+
+    void EvaluateScalar(const InputData &input, Solution &solution) {
+        auto [distance, time, score] = input.get_path_time_distance_score(solution.tour);
+        solution.distance = distance;
+        solution.time = time;
+        solution.score = score;
+    }
+}
+
+BatchEvaluator::BatchEvaluator(const InputData &input)
+        : input(input), points(input.points_count), slices(input.time_matrix.size()) {
+    vectorizable = Fits();
+    if (!vectorizable) {
+        return;
+    }
+
+    time.resize(slices * points * points);
+    for (size_t slice = 0; slice < slices; ++slice) {
+        for (size_t from = 0; from < points; ++from) {
+            std::copy(input.time_matrix[slice][from].begin(), input.time_matrix[slice][from].end(),
+                      time.begin() + static_cast<ptrdiff_t>((slice * points + from) * points));
+        }
+    }
+    distance.resize(points * points);
+    for (size_t from = 0; from < points; ++from) {
+        std::copy(input.distance_matrix[from].begin(), input.distance_matrix[from].end(),
+                  distance.begin() + static_cast<ptrdiff_t>(from * points));
+    }
+    service.assign(points, 0);
+    score.assign(points, 0);
+    for (size_t vertex = 1; vertex < points; ++vertex) {
+        service[vertex] = static_cast<double>(input.point_service_times[vertex - 1]);
+        score[vertex] = static_cast<double>(input.point_scores[vertex - 1]);
+    }
+
+    set_backend(Detect());
+}
+
+bool BatchEvaluator::Fits() const {
+    if (slices == 0 || points < 2 ||
+        slices * points * points > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        return false;
+    }
+
+    // маршрут не ограничен max_time и max_distance, поэтому суммы оцениваются по худшему случаю:
+    // points + 1 переходов, каждый с наибольшими значениями матриц и обслуживания
+    constexpr int64_t exact = int64_t{1} << 52;
+    const auto steps = static_cast<int64_t>(points) + 1;
+    int64_t max_travel = 0;
+    for (const auto &slice: input.time_matrix) {
+        for (const auto &row: slice) {
+            for (auto value: row) {
+                // отрицательное время разошлось бы с делением нацело в get_time_dependent_cost
+                if (value < 0 || value > std::numeric_limits<int32_t>::max()) {
+                    return false;
+                }
+                max_travel = std::max(max_travel, value);
+            }
+        }
+    }
+    int64_t max_distance = 0;
+    for (const auto &row: input.distance_matrix) {
+        for (auto value: row) {
+            if (value < 0 || value > std::numeric_limits<int32_t>::max()) {
+                return false;
+            }
+            max_distance = std::max(max_distance, value);
+        }
+    }
+    int64_t max_service = 0;
+    int64_t max_score = 0;
+    for (size_t vertex = 0; vertex + 1 < points; ++vertex) {
+        const auto service_time = input.point_service_times[vertex];
+        const auto importance = input.point_scores[vertex];
+        if (service_time < 0 || service_time >= exact || importance <= -exact || importance >= exact) {
+            return false;
+        }
+        max_service = std::max(max_service, service_time);
+        max_score = std::max(max_score, std::abs(importance));
+    }
+    return max_distance < exact / steps && max_travel + max_service < exact / steps &&
+           max_travel + max_score < exact / steps;
+}
+
+BatchEvaluator::Backend BatchEvaluator::Detect() {
+#ifdef BATCH_EVALUATOR_X86
+    if (__builtin_cpu_supports("avx512f")) {
+        return Backend::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return Backend::AVX2;
+    }
+#endif
+    return Backend::Scalar;
+}
+
+const char *BatchEvaluator::Name(Backend backend) {
+    switch (backend) {
+        case Backend::AVX512:
+            return "avx512";
+        case Backend::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+void BatchEvaluator::set_backend(Backend backend) {
+    const auto available = Detect();
+    if (!vectorizable || static_cast<int>(backend) > static_cast<int>(available)) {
+        backend = Backend::Scalar;
+    }
+    selected = backend;
+    narrow_available = static_cast<int>(available) >= static_cast<int>(Backend::AVX2);
+}
+
+void BatchEvaluator::evaluate(Solution *const *solutions, size_t count) {
+    const auto lanes = Lanes(selected);
+    size_t begin = 0;
+    while (begin < count) {
+        const auto length = solutions[begin]->tour.size();
+        size_t end = begin + 1;
+        while (end < count && end - begin < lanes && solutions[end]->tour.size() == length) {
+            ++end;
+        }
+
+        // короткие маршруты, одиночки и скалярный набор - по одному, как get_path_time_distance_score
+        if (selected == Backend::Scalar || end - begin == 1 || length <= 2) {
+            for (size_t i = begin; i < end; ++i) {
+                EvaluateScalar(input, *solutions[i]);
+            }
+            begin = end;
+            continue;
+        }
+
+#ifdef BATCH_EVALUATOR_X86
+        // пачку до 8 маршрутов дешевле считать в лентах AVX2, чем гонять полупустые регистры AVX-512
+        const auto kernel = selected == Backend::AVX512 && end - begin <= Lanes(Backend::AVX2) && narrow_available
+                ? Backend::AVX2 : selected;
+        const auto kernel_lanes = Lanes(kernel);
+
+        // вершины по шагам, пустые ленты повторяют первый маршрут пачки
+        lane_vertices.resize(length * kernel_lanes);
+        for (size_t lane = 0; lane < kernel_lanes; ++lane) {
+            const auto &tour = solutions[begin + lane < end ? begin + lane : begin]->tour;
+            for (size_t i = 0; i < length; ++i) {
+                lane_vertices[i * kernel_lanes + lane] = tour[i];
+            }
+        }
+
+        const Layout layout{time.data(), distance.data(), service.data(), score.data(),
+                            static_cast<int32_t>(points), static_cast<int32_t>(slices)};
+        LaneResult results[max_lanes];
+        if (kernel == Backend::AVX512) {
+            EvaluateAvx512(layout, lane_vertices.data(), kernel_lanes, length, results);
+        } else {
+            EvaluateAvx2(layout, lane_vertices.data(), kernel_lanes, length, results);
+        }
+
+        for (size_t i = begin; i < end; ++i) {
+            const auto &result = results[i - begin];
+            solutions[i]->distance = static_cast<uint32_t>(static_cast<int64_t>(result.distance));
+            solutions[i]->time = static_cast<uint32_t>(static_cast<int64_t>(result.time));
+            solutions[i]->score = static_cast<int64_t>(result.score);
+        }
+        InputData::path_evaluations += end - begin;
+        InputData::cost_evaluations += (end - begin) * (length - 1);
+#endif
+        begin = end;
+    }
+}
+
+void BatchEvaluator::evaluate(std::vector<Solution> &solutions) {
+    std::vector<Solution *> pointers(solutions.size());
+    for (size_t i = 0; i < solutions.size(); ++i) {
+        pointers[i] = &solutions[i];
+    }
+    evaluate(pointers.data(), pointers.size());
+}
@@ -0,0 +1,56 @@
+#include "../include/cancellation.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+namespace {
+    void HandleStopSignal(int signal) {
+        // в обработчике можно только атомарные операции без блокировок и signal
+        Cancellation::requested.store(true, std::memory_order_relaxed);
+        std::signal(signal, SIG_DFL);
+    }
+}
+
+namespace Cancellation {
+    void Request() {
+        requested.store(true, std::memory_order_relaxed);
+    }
+
+    void Reset() {
+        requested.store(false, std::memory_order_relaxed);
+    }
+
+    void InstallSignalHandlers() {
+        std::signal(SIGINT, HandleStopSignal);
+        std::signal(SIGTERM, HandleStopSignal);
+    }
+
+    // наблюдатели не держат ресурсов, кроме своего потока, и живут до конца процесса
+    void WatchStopFile(const std::string &path, int poll_ms) {
+        std::thread([path, poll_ms]() {
+            std::error_code error;
+            while (!Requested()) {
+                if (std::filesystem::exists(path, error)) {
+                    Request();
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(poll_ms));
+            }
+        }).detach();
+    }
+
+    void WatchStdin() {
+        std::thread([]() {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                if (line == "stop") {
+                    Request();
+                    return;
+                }
+            }
+        }).detach();
+    }
+}
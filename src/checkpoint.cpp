@@ -0,0 +1,289 @@
+#include "../include/checkpoint.hpp"
+
+#include "../include/race.hpp"
+#include "../include/timeline.hpp"
+#include "../utils/binary_parser.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    constexpr std::array<char, 4> magic = {'T', 'D', 'C', 'K'};
+    constexpr uint32_t format_version = 1;
+
+    /// больше ответов первого шага и решений в популяции не бывает, такие размеры - повреждение файла
+    constexpr uint32_t max_answers = 1 << 16;
+    constexpr uint32_t max_population = 1 << 16;
+
+    using BinaryParser::ReadValue;
+    using BinaryParser::WriteValue;
+
+    void WriteTour(std::ostream &out, const std::vector<InputData::points_type> &tour) {
+        WriteValue(out, static_cast<uint32_t>(tour.size()));
+        for (auto vertex: tour) {
+            WriteValue(out, vertex);
+        }
+    }
+
+    /// маршрут длиннее @max_size считается повреждением, @damaged отличает его от обрыва файла
+    bool ReadTour(std::istream &in, std::vector<InputData::points_type> &tour, size_t max_size, bool &damaged) {
+        uint32_t size = 0;
+        if (!ReadValue(in, size)) {
+            return false;
+        }
+        if (size > max_size) {
+            damaged = true;
+            return false;
+        }
+        tour.resize(size);
+        for (auto &vertex: tour) {
+            if (!ReadValue(in, vertex)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // сбрасывает на диск файл или каталог, иначе после падения системы rename может оказаться
+    // на диске раньше содержимого файла
+    bool Sync(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+    }
+
+    // FNV-1a по байтам значения
+    void Mix(uint64_t &hash, uint64_t value) {
+        for (size_t i = 0; i < sizeof(value); ++i) {
+            hash ^= (value >> (8 * i)) & 0xff;
+            hash *= 0x100000001b3ull;
+        }
+    }
+}
+
+namespace CheckpointFile {
+
+    uint64_t Fingerprint(const InputData &input) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        Mix(hash, input.points_count);
+        Mix(hash, input.min_load);
+        Mix(hash, input.max_load);
+        Mix(hash, input.time_matrix.size());
+        Mix(hash, static_cast<uint64_t>(input.max_time));
+        Mix(hash, static_cast<uint64_t>(input.max_distance));
+        for (auto score: input.point_scores) {
+            Mix(hash, static_cast<uint64_t>(score));
+        }
+        for (auto service: input.point_service_times) {
+            Mix(hash, static_cast<uint64_t>(service));
+        }
+        for (const auto &row: input.distance_matrix) {
+            for (auto distance: row) {
+                Mix(hash, static_cast<uint64_t>(distance));
+            }
+        }
+        return hash;
+    }
+
+    bool Write(const std::string &path, const Checkpoint &checkpoint) {
+        const auto temp_path = path + ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary);
+            if (!file) {
+                std::cerr << "Can`t open temporary file to write checkpoint" << std::endl;
+                return false;
+            }
+
+            file.write(magic.data(), magic.size());
+            WriteValue(file, format_version);
+            WriteValue(file, checkpoint.fingerprint);
+            WriteValue(file, checkpoint.seed);
+            WriteValue(file, checkpoint.generation);
+            WriteValue(file, checkpoint.elapsed_us);
+            WriteValue(file, checkpoint.incumbent);
+
+            WriteValue(file, static_cast<uint32_t>(checkpoint.answers.size()));
+            for (const auto &answer: checkpoint.answers) {
+                WriteValue(file, answer.value);
+                WriteValue(file, answer.distance);
+                WriteValue(file, answer.time);
+                WriteTour(file, answer.vertexes);
+            }
+            for (size_t i = 0; i < checkpoint.answers.size(); ++i) {
+                const auto &population = i < checkpoint.populations.size() ? checkpoint.populations[i]
+                                                                           : std::vector<Solution>{};
+                WriteValue(file, static_cast<uint32_t>(population.size()));
+                for (const auto &solution: population) {
+                    WriteValue(file, solution.distance);
+                    WriteValue(file, solution.time);
+                    WriteValue(file, solution.score);
+                    WriteTour(file, solution.tour);
+                }
+            }
+
+            if (!file.flush()) {
+                std::cerr << "Can`t write checkpoint to temporary file" << std::endl;
+                return false;
+            }
+        }
+
+        if (!Sync(temp_path)) {
+            std::cerr << "Can`t sync checkpoint temporary file" << std::endl;
+            std::remove(temp_path.c_str());
+            return false;
+        }
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+            std::cerr << "Can`t replace checkpoint file" << std::endl;
+            std::remove(temp_path.c_str());
+            return false;
+        }
+        // запись о переименовании живет в каталоге
+        auto directory = std::filesystem::path(path).parent_path();
+        if (!Sync(directory.empty() ? "." : directory.string())) {
+            std::cerr << "Can`t sync checkpoint directory" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Read(const std::string &path, size_t points_count, Checkpoint &checkpoint) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Can`t open checkpoint file" << std::endl;
+            return false;
+        }
+
+        std::array<char, 4> header{};
+        uint32_t version = 0;
+        if (!file.read(header.data(), header.size()) || header != magic ||
+            !ReadValue(file, version) || version != format_version) {
+            std::cerr << "Unknown checkpoint format" << std::endl;
+            return false;
+        }
+
+        // размеры из файла проверяются до выделения памяти: маршрут замкнут складом,
+        // поэтому в нем не больше points_count + 1 вершин
+        const size_t max_tour = points_count + 1;
+        bool damaged = false;
+        uint32_t answers = 0;
+        bool ok = ReadValue(file, checkpoint.fingerprint) && ReadValue(file, checkpoint.seed) &&
+                  ReadValue(file, checkpoint.generation) && ReadValue(file, checkpoint.elapsed_us) &&
+                  ReadValue(file, checkpoint.incumbent) && ReadValue(file, answers);
+        if (ok && answers > max_answers) {
+            ok = false;
+            damaged = true;
+        }
+
+        checkpoint.answers.assign(ok ? answers : 0, FirstStepAnswer{});
+        for (auto &answer: checkpoint.answers) {
+            ok = ok && ReadValue(file, answer.value) && ReadValue(file, answer.distance) &&
+                 ReadValue(file, answer.time) && ReadTour(file, answer.vertexes, max_tour, damaged);
+        }
+        checkpoint.populations.assign(checkpoint.answers.size(), {});
+        for (auto &population: checkpoint.populations) {
+            uint32_t size = 0;
+            ok = ok && ReadValue(file, size);
+            if (ok && size > max_population) {
+                ok = false;
+                damaged = true;
+            }
+            population.reserve(ok ? size : 0);
+            for (uint32_t k = 0; ok && k < size; ++k) {
+                Solution solution(0);
+                ok = ReadValue(file, solution.distance) && ReadValue(file, solution.time) &&
+                     ReadValue(file, solution.score) && ReadTour(file, solution.tour, max_tour, damaged);
+                population.push_back(std::move(solution));
+            }
+        }
+
+        if (damaged) {
+            std::cerr << "Checkpoint is damaged: sizes do not fit the instance" << std::endl;
+        } else if (!ok) {
+            std::cerr << "Checkpoint file is truncated" << std::endl;
+        }
+        return ok;
+    }
+}
+
+CheckpointWriter::CheckpointWriter(std::string path, std::chrono::milliseconds interval, Checkpoint base,
+                                   const Race &race, std::chrono::steady_clock::time_point start)
+        : path(std::move(path)), interval(interval), race(race), start(start), elapsed_before(base.elapsed_us),
+          next_publish(base.answers.size(), start + interval), checkpoint(std::move(base)) {
+    checkpoint.populations.resize(checkpoint.answers.size());
+    writer = std::thread([this]() { run(); });
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    stop();
+}
+
+void CheckpointWriter::stop() {
+    if (!writer.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+}
+
+void CheckpointWriter::publish(size_t thread, const std::vector<Solution> &population) {
+    auto copy = population;
+    next_publish[thread] = std::chrono::steady_clock::now() + interval;
+    std::lock_guard lock(mutex);
+    checkpoint.populations[thread] = std::move(copy);
+    dirty = true;
+}
+
+size_t CheckpointWriter::written() const {
+    std::lock_guard lock(mutex);
+    return files;
+}
+
+void CheckpointWriter::run() {
+    std::unique_lock lock(mutex);
+    while (true) {
+        // после остановки пишется последний снимок с итоговыми популяциями
+        const bool last = stopping;
+        if (dirty || last) {
+            dirty = false;
+            lock.unlock();
+            write();
+            lock.lock();
+        }
+        if (last) {
+            return;
+        }
+        wake.wait_for(lock, interval, [this]() { return stopping; });
+    }
+}
+
+void CheckpointWriter::write() {
+    TimelineSpan span("solver", "Checkpoint");
+    Checkpoint snapshot;
+    {
+        std::lock_guard lock(mutex);
+        snapshot = checkpoint;
+    }
+    snapshot.elapsed_us = elapsed_before + static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    snapshot.incumbent = std::max(snapshot.incumbent, race.incumbent());
+
+    if (CheckpointFile::Write(path, snapshot)) {
+        std::lock_guard lock(mutex);
+        ++files;
+    }
+}
@@ -1,150 +1,188 @@
 #include "../include/crossover.hpp"
+#include "../include/statistics.hpp"
+#include "../include/timeline.hpp"
+#include "../include/batch_evaluator.hpp"
 
 #include <algorithm>
 #include <stdexcept>
-#include <map>
-#include <set>
-#include <unordered_set>
 
 #ifdef DEBUG
+#include "../include/validation.hpp"
 #include "../utils/debug.h"
 #endif
 
-namespace {
-    using verteIdxType = decltype(Solution::tour)::value_type;
-
-    verteIdxType take_random_from_set(const std::unordered_set<verteIdxType>& candidates, std::mt19937& rng) {
-        auto idx = std::uniform_int_distribution<int>(0, candidates.size() - 1)(rng);
-        size_t i = 0;
-        for (auto candidate: candidates) {
-            if (i == idx) {
-                return candidate;
-            }
-            ++i;
-        }
+void Crossover::prepare(size_t path_size) {
+    // вершины маршрута - 0..path_size-2, как у подзадачи второго шага
+    const auto vertexes_count = path_size - 1;
+    if (successors.size() < 2 * vertexes_count) {
+        successors.resize(2 * vertexes_count);
+        successors_count.resize(vertexes_count);
+        pool.resize(vertexes_count);
+        pool_position.resize(vertexes_count);
+        mapping.resize(vertexes_count, no_vertex);
+        position_sum.resize(vertexes_count);
+        bucket_start.resize(2 * path_size + 1);
+        order.resize(vertexes_count);
+        marked.resize(vertexes_count);
+        first_neighbours.resize(2 * vertexes_count);
+        second_neighbours.resize(2 * vertexes_count);
+        neighbours.resize(2 * vertexes_count);
+        cycle.resize(2 * vertexes_count + 1);
+        subtour.resize(vertexes_count);
+        subtour_size.resize(vertexes_count);
+        arrival.resize(2 * vertexes_count);
+    }
+}
 
-        throw std::runtime_error("unreachable code");
+void Crossover::add_successor(vertexIdxType from, vertexIdxType to) {
+    auto &count = successors_count[from];
+    // ребро, общее для обоих родителей, храним один раз
+    if (count == 1 && successors[2 * from] == to) {
+        return;
     }
+    successors[2 * from + count] = to;
+    ++count;
 }
 
-Solution Crossover::EXX(const Solution &first, const Solution &second) {
-    size_t path_size = first.tour.size();
+void Crossover::pool_remove(vertexIdxType vertex) {
+    // удаление перестановкой с последним элементом, порядок пула не важен
+    const auto position = pool_position[vertex];
+    const auto last = pool[pool_size - 1];
+    pool[position] = last;
+    pool_position[last] = position;
+    --pool_size;
+}
 
-    using vertexIdxType = decltype(first.tour)::value_type;
-    std::map<vertexIdxType, std::set<vertexIdxType>> mapping;
+Crossover::vertexIdxType Crossover::pool_random() {
+    return pool[std::uniform_int_distribution<size_t>(0, pool_size - 1)(rng)];
+}
 
-    auto answer = Solution(0);
-    answer.tour.reserve(first.tour.size());
+Solution Crossover::EXX(const Solution &first, const Solution &second, const InputData &) {
+    const size_t path_size = first.tour.size();
+    prepare(path_size);
 
-    auto was_not_vertexes = std::unordered_set<vertexIdxType>{};
+    std::fill_n(successors_count.begin(), path_size - 1, 0);
+    pool_size = 0;
     // path_size - 2 чтобы не добавлять 0 (депо) как кандидата
     for (size_t i = 0; i < path_size - 2; ++i) {
-        was_not_vertexes.insert(i+1);
-        mapping[first.tour[i]].insert(first.tour[i + 1]);
-        mapping[second.tour[i]].insert(second.tour[i + 1]);
-    }
+        const auto vertex = static_cast<vertexIdxType>(i + 1);
+        pool[pool_size] = vertex;
+        pool_position[vertex] = pool_size;
+        ++pool_size;
 
-    answer.tour.reserve(path_size);
-    answer.tour.push_back(0);
+        add_successor(first.tour[i], first.tour[i + 1]);
+        add_successor(second.tour[i], second.tour[i + 1]);
+    }
 
-    auto candidates = std::vector<vertexIdxType>{};
-    candidates.reserve(2);
+    Solution answer(path_size);
+    answer.tour[0] = 0;
 
     for (size_t i = 1; i < path_size - 1; ++i) {
-        vertexIdxType candidate;
-        if (mapping[answer.tour[i - 1]].size() == 1) {
-            candidate = *mapping[answer.tour[i - 1]].cbegin();
-            // в случае если кандидат уже был в пути
-            if (was_not_vertexes.find(candidate) == was_not_vertexes.end()) {
-                candidate = take_random_from_set(was_not_vertexes, rng);
+        const auto previous = answer.tour[i - 1];
+        const auto *next = &successors[2 * previous];
+
+        // непосещенные последователи предыдущей вершины в родителях
+        vertexIdxType candidates[2];
+        size_t candidates_count = 0;
+        for (uint8_t k = 0; k < successors_count[previous]; ++k) {
+            if (pool_position[next[k]] < pool_size && pool[pool_position[next[k]]] == next[k]) {
+                candidates[candidates_count++] = next[k];
             }
+        }
+
+        vertexIdxType candidate;
+        if (candidates_count == 0) {
+            // в случае если нет доступных канидатов
+            candidate = pool_random();
+        } else if (candidates_count == 1) {
+            candidate = candidates[0];
         } else {
-            candidates.clear();
-            for (auto idx : mapping[answer.tour[i - 1]]) {
-                if (was_not_vertexes.find(idx) != was_not_vertexes.end()) {
-                    candidates.push_back(idx);
-                }
-            }
-            if (candidates.size() == 0) {
-                // в случае если нет доступных канидатов
-                candidate = take_random_from_set(was_not_vertexes, rng);
-            } else {
-                auto idx = std::uniform_int_distribution<int>(0, candidates.size() - 1)(rng);
-                candidate = candidates[idx];
-            }
+            candidate = candidates[std::uniform_int_distribution<int>(0, 1)(rng)];
         }
-        answer.tour.push_back(candidate);
-        was_not_vertexes.erase(candidate);
+
+        answer.tour[i] = candidate;
+        pool_remove(candidate);
     }
-    answer.tour.push_back(0);
+    answer.tour[path_size - 1] = 0;
 
     return answer; // RVO
 }
 
 // https://en.wikipedia.org/wiki/Crossover_(evolutionary_algorithm)#Partially_mapped_crossover_(PMX)
-Solution Crossover::PMX(const Solution &first, const Solution &second) {
+Solution Crossover::PMX(const Solution &first, const Solution &second, const InputData &) {
 
     auto path_size = first.tour.size();
     auto answer = first;
 
-    using verteIdxType = decltype(first.tour)::value_type;
-
     if (path_size <= 4)[[unlikely]] {
         return answer; // RVO
     }
+    prepare(path_size);
 
-    int start = std::uniform_int_distribution<int>(1, path_size - 3)(rng);
-    int end = std::uniform_int_distribution<int>(start + 1, path_size - 1)(rng);
+    size_t start = std::uniform_int_distribution<size_t>(1, path_size - 3)(rng);
+    size_t end = std::uniform_int_distribution<size_t>(start + 1, path_size - 1)(rng);
+    // конечное депо отображается само в себя, его не отмечаем
+    const size_t mapped_end = std::min(end, path_size - 2);
 
-    std::map<verteIdxType, verteIdxType> first2second;
-
-    for (size_t i = start; i <= end; ++i) {
-        first2second[first.tour[i]] = second.tour[i];
+    for (size_t i = start; i <= mapped_end; ++i) {
+        mapping[first.tour[i]] = second.tour[i];
     }
 
-    for (size_t i = 1; i < start; ++i) {
-        auto candidate = second.tour[i];
-        while(first2second.find(candidate) != first2second.end()) {
-            candidate = first2second.at(candidate);
+    auto resolve = [this](vertexIdxType candidate) {
+        while (mapping[candidate] != no_vertex) {
+            candidate = mapping[candidate];
         }
-        answer.tour[i] = candidate;
+        return candidate;
+    };
+
+    for (size_t i = 1; i < start; ++i) {
+        answer.tour[i] = resolve(second.tour[i]);
     }
 
     for (size_t i = end + 1; i < path_size - 1; ++i) {
-        auto candidate = second.tour[i];
-        while(first2second.find(candidate) != first2second.end()) {
-            candidate = first2second.at(candidate);
-        }
-        answer.tour[i] = candidate;
+        answer.tour[i] = resolve(second.tour[i]);
+    }
+
+    // сбрасываем только затронутые ячейки, чтобы не платить O(n) за очистку
+    for (size_t i = start; i <= mapped_end; ++i) {
+        mapping[first.tour[i]] = no_vertex;
     }
 
     return answer; // RVO
 }
 
-Solution Crossover::SC(const Solution &first, const Solution &second) {
+Solution Crossover::SC(const Solution &first, const Solution &second, const InputData &) {
 
-    size_t path_size = first.tour.size();
-    std::vector<std::pair<decltype(first.tour)::value_type, int>> idx(path_size - 1);
+    const size_t path_size = first.tour.size();
+    prepare(path_size);
 
-    // считаем сумму позиций вершин для всех кроме депо
+    // сумма позиций вершины в обоих родителях лежит в [2, 2 * (path_size - 2)]
+    const size_t max_sum = 2 * (path_size - 2);
+    std::fill_n(bucket_start.begin(), max_sum + 2, 0);
     for (size_t i = 1; i < path_size - 1; ++i) {
-        idx[first.tour[i]].first = first.tour[i];
-        idx[first.tour[i]].second += static_cast<int>(i);
-
-        idx[second.tour[i]].first = second.tour[i];
-        idx[second.tour[i]].second += static_cast<int>(i);
+        position_sum[first.tour[i]] = static_cast<uint32_t>(i);
+    }
+    for (size_t i = 1; i < path_size - 1; ++i) {
+        position_sum[second.tour[i]] += static_cast<uint32_t>(i);
     }
 
-    // сдвинули начало на 1 чтобы не учитывать индекс депо - 0
-    std::sort(idx.begin() + 1, idx.end(),
-              [](const auto &a, const auto &b) { return a.second < b.second; });
+    // сортировка подсчетом по сумме позиций, при равенстве - по номеру вершины
+    for (vertexIdxType vertex = 1; vertex < path_size - 1; ++vertex) {
+        ++bucket_start[position_sum[vertex] + 1];
+    }
+    for (size_t sum = 1; sum <= max_sum + 1; ++sum) {
+        bucket_start[sum] += bucket_start[sum - 1];
+    }
+    for (vertexIdxType vertex = 1; vertex < path_size - 1; ++vertex) {
+        order[bucket_start[position_sum[vertex]]++] = vertex;
+    }
 
     Solution answer(path_size);
 
     // депо всегда первое
     answer.tour[0] = 0;
     for (size_t i = 1; i < path_size - 1; ++i) {
-        answer.tour[i] = idx[i].first;
+        answer.tour[i] = order[i - 1];
     }
     // депо всегда завершает маршрут
     answer.tour[path_size - 1] = 0;
@@ -152,89 +190,449 @@ Solution Crossover::SC(const Solution &first, const Solution &second) {
     return answer; // RVO
 }
 
-Solution Crossover::crossover(const Solution &first, const Solution &second, const InputData &inputData) {
+// https://en.wikipedia.org/wiki/Crossover_(evolutionary_algorithm)#Order_crossover_(OX1)
+Solution Crossover::OX(const Solution &first, const Solution &second, const InputData &) {
 
-#ifdef DEBUG
-    std::cout << "Crossover\nFirst tour:\n";
-    std::cout << first << std::endl;
-    std::cout << "---------------------------------\nSecond tour:\n";
-    std::cout << second << std::endl;
-#endif
+    const size_t path_size = first.tour.size();
+    auto answer = first;
 
-    if (first.tour.size() != second.tour.size()) [[unlikely]] {
-        throw std::runtime_error("Different tours sizes");
+    if (path_size <= 4)[[unlikely]] {
+        return answer; // RVO
     }
+    prepare(path_size);
 
-    Solution result(0);
-    auto type = std::uniform_int_distribution<int>(0,2)(rng);
-    switch (type) {
-        case 0: {
-            result = EXX(first, second);
-            break;
+    // отрезок [start, end] берется из первого родителя, депо в него не попадает
+    const size_t last = path_size - 2;
+    size_t start = std::uniform_int_distribution<size_t>(1, last)(rng);
+    size_t end = std::uniform_int_distribution<size_t>(start, last)(rng);
+
+    for (size_t i = start; i <= end; ++i) {
+        marked[first.tour[i]] = 1;
+    }
+
+    // остальные позиции заполняются по кругу после отрезка в порядке второго родителя
+    size_t position = end == last ? 1 : end + 1;
+    size_t source = position;
+    for (size_t filled = 0; filled < last - (end - start + 1); ++source) {
+        if (source > last) {
+            source = 1;
         }
-        case 1: {
-            result = PMX(first, second);
-            break;
+        const auto vertex = second.tour[source];
+        if (marked[vertex]) {
+            continue;
         }
-        default: {
-            result = SC(first, second);
-            break;
+        answer.tour[position] = vertex;
+        ++filled;
+        position = position == last ? 1 : position + 1;
+    }
+
+    for (size_t i = start; i <= end; ++i) {
+        marked[first.tour[i]] = 0;
+    }
+
+    return answer; // RVO
+}
+
+void Crossover::fill_neighbours(const Path &tour, std::vector<vertexIdxType> &result) {
+    // последнее депо совпадает с первым, в цикле path_size - 1 вершин
+    const size_t cycle_size = tour.size() - 1;
+    for (size_t i = 0; i < cycle_size; ++i) {
+        const auto vertex = tour[i];
+        result[2 * vertex] = tour[i == 0 ? cycle_size - 1 : i - 1];
+        result[2 * vertex + 1] = tour[i + 1];
+    }
+}
+
+void Crossover::replace_neighbour(vertexIdxType vertex, vertexIdxType from, vertexIdxType to) {
+    auto *slots = &neighbours[2 * vertex];
+    slots[slots[0] == from ? 0 : 1] = to;
+}
+
+// Nagata, Kobayashi. A Powerful Genetic Algorithm Using Edge Assembly Crossover for the TSP.
+// Берется один AB-цикл: ребра первого родителя на нем удаляются, ребра второго добавляются.
+// Ребра считаются неориентированными, направление обхода выбирается как у первого родителя.
+Solution Crossover::EAX(const Solution &first, const Solution &second, const InputData &inputData) {
+
+    const size_t path_size = first.tour.size();
+    auto answer = first;
+
+    if (path_size <= 5)[[unlikely]] {
+        return answer; // RVO
+    }
+    prepare(path_size);
+
+    const size_t cycle_size = path_size - 1;
+    fill_neighbours(first.tour, first_neighbours);
+    fill_neighbours(second.tour, second_neighbours);
+
+    // marked[v]: биты 0-1 - ребра первого родителя у v уже использованы, биты 2-3 - ребра второго.
+    // Общие ребра AB-цикл не меняют, их сразу отмечаем использованными.
+    size_t free_edges = 0;
+    for (vertexIdxType vertex = 0; vertex < cycle_size; ++vertex) {
+        uint8_t flags = 0;
+        for (int k = 0; k < 2; ++k) {
+            const auto a = first_neighbours[2 * vertex + k];
+            if (a == second_neighbours[2 * vertex] || a == second_neighbours[2 * vertex + 1]) {
+                flags |= uint8_t(1) << k;
+            } else {
+                ++free_edges;
+            }
+            const auto b = second_neighbours[2 * vertex + k];
+            if (b == first_neighbours[2 * vertex] || b == first_neighbours[2 * vertex + 1]) {
+                flags |= uint8_t(4) << k;
+            }
         }
+        marked[vertex] = flags;
     }
 
-    auto [distance, time, score] = inputData.get_path_time_distance_score(result.tour);
-    result.time = time, result.distance = distance, result.score = score;
+    if (free_edges == 0) {
+        // у родителей одинаковые множества ребер
+        std::fill_n(marked.begin(), cycle_size, 0);
+        return answer; // RVO
+    }
 
-#ifdef DEBUG
-    std::cout << "Tour after ";
-    switch (type) {
-        case 0: {
-            std::cout << "EXX";
+    // отмечает ребро u-v родителя @bit (0 - первый, 2 - второй) использованным с обеих сторон
+    auto take = [this](vertexIdxType u, vertexIdxType v, int bit) {
+        const auto &table = bit == 0 ? first_neighbours : second_neighbours;
+        marked[u] |= uint8_t(1) << (bit + (table[2 * u] == v ? 0 : 1));
+        marked[v] |= uint8_t(1) << (bit + (table[2 * v] == u ? 0 : 1));
+    };
+
+    // начало цикла - вершина со свободным ребром первого родителя
+    auto start = static_cast<vertexIdxType>(std::uniform_int_distribution<size_t>(0, cycle_size - 1)(rng));
+    while ((marked[start] & 3) == 3) {
+        start = start + 1 == cycle_size ? 0 : start + 1;
+    }
+
+    // У каждой вершины свободных ребер первого и второго родителя поровну, поэтому
+    // попеременный обход не застревает и возвращается в start по ребру второго родителя
+    size_t cycle_length = 0;
+    cycle[cycle_length++] = start;
+    auto current = start;
+    for (int bit = 0;; bit ^= 2) {
+        const auto &table = bit == 0 ? first_neighbours : second_neighbours;
+        const unsigned free = (~static_cast<unsigned>(marked[current]) >> bit) & 3;
+        const int slot = free == 3 ? std::uniform_int_distribution<int>(0, 1)(rng) : (free == 1 ? 0 : 1);
+        const auto next = table[2 * current + slot];
+        take(current, next, bit);
+        cycle[cycle_length++] = next;
+        current = next;
+        if (bit == 2 && current == start) {
             break;
         }
-        case 1: {
-            std::cout << "PMX";
-            break;
+    }
+    std::fill_n(marked.begin(), cycle_size, 0);
+
+    // промежуточное решение: первый родитель без ребер цикла из него и с ребрами цикла из второго
+    std::copy_n(first_neighbours.begin(), 2 * cycle_size, neighbours.begin());
+    for (size_t i = 0; i + 1 < cycle_length; i += 2) {
+        replace_neighbour(cycle[i], cycle[i + 1], no_vertex);
+        replace_neighbour(cycle[i + 1], cycle[i], no_vertex);
+    }
+    for (size_t i = 1; i + 1 < cycle_length; i += 2) {
+        replace_neighbour(cycle[i], no_vertex, cycle[i + 1]);
+        replace_neighbour(cycle[i + 1], no_vertex, cycle[i]);
+    }
+
+    // разметка подтуров
+    std::fill_n(subtour.begin(), cycle_size, std::numeric_limits<uint32_t>::max());
+    uint32_t subtours_count = 0;
+    for (vertexIdxType vertex = 0; vertex < cycle_size; ++vertex) {
+        if (subtour[vertex] != std::numeric_limits<uint32_t>::max()) {
+            continue;
         }
-        default: {
-            std::cout << "SC";
-            break;
+        subtour_size[subtours_count] = 0;
+        auto previous = neighbours[2 * vertex + 1];
+        auto cur = vertex;
+        while (subtour[cur] == std::numeric_limits<uint32_t>::max()) {
+            subtour[cur] = subtours_count;
+            ++subtour_size[subtours_count];
+            const auto next = neighbours[2 * cur] != previous ? neighbours[2 * cur] : neighbours[2 * cur + 1];
+            previous = cur;
+            cur = next;
         }
+        ++subtours_count;
     }
-    std::cout << ":\n";
-    std::cout << result << std::endl;
 
-    // проверка размера маршрута
-    if (result.tour.size() != first.tour.size()) {
-        throw std::runtime_error("Crossover produced invalid tour size");
+    const auto &distances = inputData.distance_matrix;
+    auto distance = [&distances](vertexIdxType u, vertexIdxType v) {
+        return distances[u][v] + distances[v][u];
+    };
+
+    // наименьший подтур соединяется с остальными заменой двух ребер на два с наименьшим приростом длины
+    for (uint32_t merges = 1; merges < subtours_count; ++merges) {
+        uint32_t smallest = subtour[0];
+        for (vertexIdxType vertex = 0; vertex < cycle_size; ++vertex) {
+            if (subtour_size[subtour[vertex]] < subtour_size[smallest]) {
+                smallest = subtour[vertex];
+            }
+        }
+
+        int64_t best_delta = std::numeric_limits<int64_t>::max();
+        vertexIdxType best_u = 0, best_u2 = 0, best_v = 0, best_v2 = 0;
+        bool crossed = false;
+        for (vertexIdxType u = 0; u < cycle_size; ++u) {
+            if (subtour[u] != smallest) {
+                continue;
+            }
+            const auto u2 = neighbours[2 * u + 1];
+            const auto removed_u = distance(u, u2);
+            for (vertexIdxType v = 0; v < cycle_size; ++v) {
+                if (subtour[v] == smallest) {
+                    continue;
+                }
+                for (int k = 0; k < 2; ++k) {
+                    const auto v2 = neighbours[2 * v + k];
+                    const auto removed = removed_u + distance(v, v2);
+                    const auto straight = distance(u, v) + distance(u2, v2) - removed;
+                    const auto cross = distance(u, v2) + distance(u2, v) - removed;
+                    if (straight < best_delta) {
+                        best_delta = straight, best_u = u, best_u2 = u2, best_v = v, best_v2 = v2, crossed = false;
+                    }
+                    if (cross < best_delta) {
+                        best_delta = cross, best_u = u, best_u2 = u2, best_v = v, best_v2 = v2, crossed = true;
+                    }
+                }
+            }
+        }
+
+        if (crossed) {
+            std::swap(best_v, best_v2);
+        }
+        // ребра u-u2 и v-v2 заменяются на u-v и u2-v2
+        replace_neighbour(best_u, best_u2, best_v);
+        replace_neighbour(best_u2, best_u, best_v2);
+        replace_neighbour(best_v, best_v2, best_u);
+        replace_neighbour(best_v2, best_v, best_u2);
+
+        const auto target = subtour[best_v];
+        for (vertexIdxType vertex = 0; vertex < cycle_size; ++vertex) {
+            if (subtour[vertex] == smallest) {
+                subtour[vertex] = target;
+            }
+        }
+        subtour_size[target] += subtour_size[smallest];
+        subtour_size[smallest] = 0;
     }
-    
-    // проверка депо в начале и конце маршрута
-    if (result.tour.front() != 0 || result.tour.back() != 0) {
-        throw std::runtime_error("Crossover produced invalid tour: depot not at start/end");
+
+    // обход из депо в сторону первого шага первого родителя, если это ребро сохранилось
+    auto previous = neighbours[0] == first.tour[1] ? neighbours[1] : neighbours[0];
+    vertexIdxType current_vertex = 0;
+    for (size_t i = 1; i < cycle_size; ++i) {
+        const auto next = neighbours[2 * current_vertex] != previous ? neighbours[2 * current_vertex]
+                                                                     : neighbours[2 * current_vertex + 1];
+        answer.tour[i] = next;
+        previous = current_vertex;
+        current_vertex = next;
     }
-    
-    // проверка наличия всех вершин (кроме депо)
-    std::unordered_set<decltype(first.tour)::value_type> vertices_in_result;
-    for (size_t i = 1; i < result.tour.size() - 1; ++i) {
-        if (vertices_in_result.find(result.tour[i]) != vertices_in_result.end()) { 
-            // нашли дубликат вершины
-            std::cout << result.tour[i] << std::endl;
-            throw std::runtime_error("Crossover produced invalid tour: duplicate vertices");
+    answer.tour[path_size - 1] = 0;
+
+    return answer; // RVO
+}
+
+Solution Crossover::TDMerge(const Solution &first, const Solution &second, const InputData &inputData) {
+
+    const size_t path_size = first.tour.size();
+    prepare(path_size);
+
+    const size_t cycle_size = path_size - 1;
+    fill_neighbours(first.tour, first_neighbours);
+    fill_neighbours(second.tour, second_neighbours);
+
+    // время прибытия в вершину в каждом из родителей
+    for (int parent = 0; parent < 2; ++parent) {
+        const auto &tour = parent == 0 ? first.tour : second.tour;
+        int64_t time = 0;
+        for (size_t i = 1; i < cycle_size; ++i) {
+            time += inputData.get_time_dependent_cost(time, tour[i - 1], tour[i]);
+            arrival[2 * tour[i] + parent] = time;
+            time += inputData.point_service_times[tour[i] - 1];
         }
-        vertices_in_result.insert(result.tour[i]);
     }
-    
-    // проверка что набор вершин тот же что и в родительском маршруте
-    std::unordered_set<decltype(first.tour)::value_type> vertices_in_first;
-    for (size_t i = 1; i < first.tour.size() - 1; ++i) {
-        vertices_in_first.insert(first.tour[i]);
+
+    // вершины по сумме времен прибытия в родителях, при равенстве - по номеру
+    for (size_t i = 1; i < cycle_size; ++i) {
+        order[i - 1] = static_cast<vertexIdxType>(i);
     }
-    
-    if (vertices_in_result != vertices_in_first) {
-        throw std::runtime_error("Crossover produced invalid tour: missing or extra vertices");
+    std::sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(cycle_size - 1),
+              [this](vertexIdxType a, vertexIdxType b) {
+                  const auto key_a = arrival[2 * a] + arrival[2 * a + 1];
+                  const auto key_b = arrival[2 * b] + arrival[2 * b + 1];
+                  return key_a != key_b ? key_a < key_b : a < b;
+              });
+
+    Solution answer(path_size);
+    answer.tour[0] = 0;
+
+    size_t earliest = 0;
+    int64_t time = 0;
+    for (size_t i = 1; i < cycle_size; ++i) {
+        const auto current = answer.tour[i - 1];
+        while (marked[order[earliest]]) {
+            ++earliest;
+        }
+
+        // кандидаты: следующая вершина в каждом родителе и непосещенная вершина,
+        // в которую родители в среднем приезжают раньше всех
+        const vertexIdxType candidates[3] = {
+            order[earliest], first_neighbours[2 * current + 1], second_neighbours[2 * current + 1]
+        };
+        vertexIdxType best = candidates[0];
+        int64_t best_travel = inputData.get_time_dependent_cost(time, current, best);
+        for (size_t k = 1; k < 3; ++k) {
+            const auto candidate = candidates[k];
+            if (candidate == 0 || marked[candidate] || candidate == best) {
+                continue;
+            }
+            const auto travel = inputData.get_time_dependent_cost(time, current, candidate);
+            if (travel < best_travel) {
+                best = candidate, best_travel = travel;
+            }
+        }
+
+        answer.tour[i] = best;
+        marked[best] = 1;
+        time += best_travel + inputData.point_service_times[best - 1];
+    }
+    answer.tour[path_size - 1] = 0;
+
+    std::fill_n(marked.begin(), cycle_size, 0);
+
+    return answer; // RVO
+}
+
+const std::array<Crossover::Operator, crossover_types.size()> Crossover::operators = {{
+    {CrossoverType::EXX, &Crossover::EXX},
+    {CrossoverType::PMX, &Crossover::PMX},
+    {CrossoverType::SC, &Crossover::SC},
+    {CrossoverType::OX, &Crossover::OX},
+    {CrossoverType::EAX, &Crossover::EAX},
+    {CrossoverType::TDMerge, &Crossover::TDMerge},
+}};
+
+CrossoverType Crossover::select() {
+    // пока у оператора мало замеров, запускаем его вне очереди
+    size_t least_reported = 0;
+    for (size_t i = 1; i < scores.size(); ++i) {
+        if (scores[i].reports < scores[least_reported].reports) {
+            least_reported = i;
+        }
+    }
+    if (scores[least_reported].reports < warmup_reports) {
+        return operators[least_reported].type;
+    }
+
+    // вероятность пропорциональна награде на микросекунду процессорного времени,
+    // но не ниже min_probability
+    std::array<double, crossover_types.size()> efficiency{};
+    double total = 0;
+    for (size_t i = 0; i < scores.size(); ++i) {
+        efficiency[i] = scores[i].reward / std::max(scores[i].cpu_us, 1.0);
+        total += efficiency[i];
+    }
+
+    const double uniform = 1.0 / static_cast<double>(scores.size());
+    const double spread = 1.0 - min_probability * static_cast<double>(scores.size());
+    double point = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    for (size_t i = 0; i + 1 < scores.size(); ++i) {
+        point -= total > 0 ? min_probability + spread * efficiency[i] / total : uniform;
+        if (point < 0) {
+            return operators[i].type;
+        }
+    }
+    return operators.back().type;
+}
+
+Solution Crossover::crossover(const Solution &first, const Solution &second, const InputData &inputData) {
+    auto type = select();
+    pending_start_us = ThreadCpuTimeUs();
+    pending = true;
+    return crossover(type, first, second, inputData);
+}
+
+Solution Crossover::crossover(const std::vector<std::pair<const Solution *, const Solution *>> &parents,
+                              const InputData &inputData, BatchEvaluator &evaluator) {
+    auto type = select();
+    pending_start_us = ThreadCpuTimeUs();
+    pending = true;
+    crossover_batch(type, parents, inputData, evaluator, batch_children);
+    auto best = std::max_element(batch_children.begin(), batch_children.end(),
+                                 [](const auto &sol1, const auto &sol2) { return sol1.score < sol2.score; });
+    return std::move(*best);
+}
+
+void Crossover::report(double reward) {
+    if (!pending) {
+        return;
+    }
+    pending = false;
+
+    const auto elapsed = ThreadCpuTimeUs() - pending_start_us;
+    const auto index = static_cast<size_t>(last_applied);
+    LocalStatistics().crossover_cpu_us[index] += elapsed;
+
+    // первые замеры усредняются поровну, дальше - экспоненциальное забывание
+    auto &score = scores[index];
+    ++score.reports;
+    const double weight = std::max(score_decay, 1.0 / static_cast<double>(score.reports));
+    score.reward += weight * (reward - score.reward);
+    score.cpu_us += weight * (static_cast<double>(elapsed) - score.cpu_us);
+}
+
+Solution Crossover::build(CrossoverType type, const Solution &first, const Solution &second,
+                          const InputData &inputData) {
+
+#ifdef DEBUG
+    std::cout << "Crossover\nFirst tour:\n";
+    std::cout << first << std::endl;
+    std::cout << "---------------------------------\nSecond tour:\n";
+    std::cout << second << std::endl;
+#endif
+
+    if (first.tour.size() != second.tour.size()) [[unlikely]] {
+        throw std::runtime_error("Different tours sizes");
+    }
+
+    TimelineSpan span("crossover", SearchStatistics::crossover_names[static_cast<size_t>(type)]);
+    last_applied = type;
+    ++LocalStatistics().crossover_applied[static_cast<size_t>(type)];
+
+    auto result = (this->*operators[static_cast<size_t>(type)].build)(first, second, inputData);
+
+#ifdef DEBUG
+    std::cout << "Tour after " << SearchStatistics::crossover_names[static_cast<size_t>(type)];
+    std::cout << ":\n";
+    std::cout << result << std::endl;
+
+    // маршрут потомка корректен и обходит те же вершины, что и родитель
+    if (auto error = Validation::CheckTour(inputData, result.tour); !error.empty()) {
+        throw std::runtime_error("Crossover produced invalid tour: " + error);
+    }
+    if (auto error = Validation::CheckSameVertices(result.tour, first.tour); !error.empty()) {
+        throw std::runtime_error("Crossover produced invalid tour: " + error);
     }
 #endif
     
     return result; // RVO
+}
+
+Solution Crossover::crossover(CrossoverType type, const Solution &first, const Solution &second,
+                              const InputData &inputData) {
+    auto result = build(type, first, second, inputData);
+    auto [distance, time, score] = inputData.get_path_time_distance_score(result.tour);
+    result.time = time, result.distance = distance, result.score = score;
+    return result; // RVO
+}
+
+void Crossover::crossover_batch(CrossoverType type,
+                                const std::vector<std::pair<const Solution *, const Solution *>> &parents,
+                                const InputData &inputData, BatchEvaluator &evaluator,
+                                std::vector<Solution> &children) {
+    children.clear();
+    children.reserve(parents.size());
+    for (const auto &[first, second]: parents) {
+        children.push_back(build(type, *first, *second, inputData));
+    }
+    // потомки одной длины, поэтому идут в ленты пачками по BatchEvaluator::max_lanes
+    evaluator.evaluate(children);
 }
\ No newline at end of file
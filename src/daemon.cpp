@@ -0,0 +1,464 @@
+#include "../include/daemon.hpp"
+
+#include "../include/solver.hpp"
+#include "../utils/json_parser.hpp"
+#include "../utils/binary_parser.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    using json = nlohmann::json;
+
+    // FNV-1a, для идентификации задачи по содержимому криптостойкость не нужна
+    std::string ContentHash(const std::string &data) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c: data) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+
+        std::ostringstream os;
+        os << std::hex << hash;
+        return os.str();
+    }
+
+    // Кэш распарсенных задач с вытеснением давно не использованных (LRU)
+    class InstanceCache {
+    public:
+        explicit InstanceCache(size_t capacity) : capacity(capacity) {}
+
+        std::shared_ptr<const InputData> Find(const std::string &id) {
+            std::lock_guard lock(mutex);
+            auto it = entries.find(id);
+            if (it == entries.end()) {
+                return nullptr;
+            }
+            order.splice(order.begin(), order, it->second.second);
+            return it->second.first;
+        }
+
+        void Insert(const std::string &id, std::shared_ptr<const InputData> input) {
+            std::lock_guard lock(mutex);
+            if (entries.find(id) != entries.end()) {
+                return;
+            }
+            if (entries.size() == capacity) {
+                entries.erase(order.back());
+                order.pop_back();
+            }
+            order.push_front(id);
+            entries.emplace(id, std::make_pair(std::move(input), order.begin()));
+        }
+
+    private:
+        size_t capacity;
+        std::mutex mutex;
+        // в начале списка - последние использованные задачи
+        std::list<std::string> order;
+        std::unordered_map<std::string,
+                std::pair<std::shared_ptr<const InputData>, std::list<std::string>::iterator>> entries;
+    };
+
+    // Ограниченный пул воркеров: каждый Solve сам запускает потоки под ответы первого шага,
+    // поэтому одновременно решаемых задач должно быть немного
+    class WorkerPool {
+    public:
+        explicit WorkerPool(size_t workers_count) {
+            workers.reserve(workers_count);
+            for (size_t i = 0; i < workers_count; ++i) {
+                workers.emplace_back([this]() { Work(); });
+            }
+        }
+
+        // дожидается выполнения всех поставленных задач
+        ~WorkerPool() {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            cv.notify_all();
+            for (auto &worker: workers) {
+                worker.join();
+            }
+        }
+
+        void Submit(std::function<void()> task) {
+            {
+                std::lock_guard lock(mutex);
+                tasks.push_back(std::move(task));
+            }
+            cv.notify_one();
+        }
+
+    private:
+        void Work() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(mutex);
+                    cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                    if (tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> tasks;
+        std::vector<std::thread> workers;
+        bool stopping = false;
+    };
+
+    // Канал ответов, ответы разных воркеров не должны перемешиваться внутри строки
+    class ResponseSink {
+    public:
+        explicit ResponseSink(int fd) : fd(fd) {}
+
+        ~ResponseSink() {
+            if (fd != STDOUT_FILENO) {
+                close(fd);
+            }
+        }
+
+        void Write(const json &response) {
+            auto line = response.dump() + "\n";
+
+            std::lock_guard lock(mutex);
+            size_t written = 0;
+            while (written < line.size()) {
+                // в сокет - без SIGPIPE, отключившийся клиент не должен завершать демон
+                auto res = fd == STDOUT_FILENO ? write(fd, line.data() + written, line.size() - written)
+                                               : send(fd, line.data() + written, line.size() - written, MSG_NOSIGNAL);
+                if (res < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (res <= 0) {
+                    // клиент отключился (EPIPE, ECONNRESET), ответ некому отдавать
+                    return;
+                }
+                written += res;
+            }
+        }
+
+    private:
+        int fd;
+        std::mutex mutex;
+    };
+
+    // Потоки соединений сокета. Они обращаются к пулу и кэшу RunDaemon, поэтому не отсоединяются,
+    // а дожидаются в Close перед выходом из ServeSocket
+    class Connections {
+    public:
+        ~Connections() {
+            Close();
+        }
+
+        void Start(int fd, std::function<void(int, std::shared_ptr<ResponseSink>)> serve) {
+            std::lock_guard lock(mutex);
+            Reap();
+            auto &connection = active.emplace_back();
+            connection.fd = fd;
+            // сокет закроется, когда будет отправлен последний ответ и чтение запросов закончится,
+            // до этого shutdown в Close не может попасть в чужой дескриптор
+            connection.sink = std::make_shared<ResponseSink>(fd);
+            connection.thread = std::thread([this, &connection, serve = std::move(serve)]() {
+                serve(connection.fd, connection.sink);
+                std::lock_guard lock(mutex);
+                connection.done = true;
+                connection.sink.reset();
+            });
+        }
+
+        // прерывает чтение запросов во всех соединениях и дожидается их потоков,
+        // уже принятые запросы дорешиваются пулом
+        void Close() {
+            std::list<Connection> closing;
+            {
+                std::lock_guard lock(mutex);
+                for (auto &connection: active) {
+                    if (!connection.done) {
+                        shutdown(connection.fd, SHUT_RD);
+                    }
+                }
+                closing.splice(closing.end(), active);
+            }
+            for (auto &connection: closing) {
+                connection.thread.join();
+            }
+        }
+
+    private:
+        struct Connection {
+            int fd = -1;
+            std::shared_ptr<ResponseSink> sink;
+            std::thread thread;
+            bool done = false;
+        };
+
+        // забирает завершившиеся соединения, вызывается под блокировкой
+        void Reap() {
+            for (auto it = active.begin(); it != active.end();) {
+                if (it->done) {
+                    it->thread.join();
+                    it = active.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        std::mutex mutex;
+        std::list<Connection> active;
+    };
+
+    // идентификатор по бинарной сериализации задачи: одна и та же задача, присланная json, файлом json
+    // или файлом .bin, попадает в одну запись кэша
+    std::string InstanceId(const InputData &input) {
+        std::ostringstream out;
+        BinaryParser::WriteInputData(out, input);
+        return ContentHash(out.str());
+    }
+
+    // кладет в кэш только что распарсенную задачу, если такой там еще нет
+    std::shared_ptr<const InputData> Remember(std::shared_ptr<InputData> input, InstanceCache &cache,
+                                              std::string &instance_id) {
+        instance_id = InstanceId(*input);
+        if (auto cached = cache.Find(instance_id)) {
+            return cached;
+        }
+        cache.Insert(instance_id, input);
+        return input;
+    }
+
+    std::shared_ptr<const InputData> LoadInstance(const json &request, InstanceCache &cache, std::string &instance_id) {
+        if (request.contains("instance")) {
+            auto input = std::make_shared<InputData>();
+            JsonParser::ParseInputData(request.at("instance"), *input);
+            return Remember(std::move(input), cache, instance_id);
+        }
+
+        if (request.contains("instance_path")) {
+            const auto path = request.at("instance_path").get<std::string>();
+            auto input = std::make_shared<InputData>();
+            if (BinaryParser::IsBinaryPath(path)) {
+                if (!BinaryParser::ParseInputDataFromBinary(path, *input)) {
+                    throw std::runtime_error("invalid binary instance");
+                }
+            } else {
+                std::ifstream file(path);
+                if (!file) {
+                    throw std::runtime_error("can`t open instance_path");
+                }
+                JsonParser::ParseInputData(json::parse(file), *input);
+            }
+            return Remember(std::move(input), cache, instance_id);
+        }
+
+        if (request.contains("instance_id")) {
+            instance_id = request.at("instance_id").get<std::string>();
+            if (auto cached = cache.Find(instance_id)) {
+                return cached;
+            }
+            throw std::runtime_error("unknown instance_id, send instance first");
+        }
+
+        throw std::runtime_error("request has no instance, instance_path or instance_id");
+    }
+
+    json HandleRequest(const std::string &line, InstanceCache &cache, const ProgramArguments &defaults) {
+        json response;
+        try {
+            auto request = json::parse(line);
+            if (request.contains("id")) {
+                response["id"] = request.at("id");
+            }
+
+            std::string instance_id;
+            auto instance = LoadInstance(request, cache, instance_id);
+
+            auto args = defaults;
+            if (request.contains("time")) {
+                request.at("time").get_to(args.time);
+            }
+            if (request.contains("meta")) {
+                JsonParser::ParseMetaParameters(request.at("meta"), args.meta);
+            }
+
+            // задача из кэша копируется только если скоры переопределены в запросе
+            const InputData *input = instance.get();
+            InputData overridden;
+            if (request.contains("point_scores") || request.contains("score_overrides")) {
+                overridden = *instance;
+                input = &overridden;
+            }
+            if (request.contains("point_scores")) {
+                auto scores = request.at("point_scores").get<std::vector<int64_t>>();
+                if (scores.size() != overridden.point_scores.size()) {
+                    throw std::runtime_error("point_scores size mismatch");
+                }
+                overridden.point_scores = std::move(scores);
+            }
+            if (request.contains("score_overrides")) {
+                for (const auto &[point, score]: request.at("score_overrides").items()) {
+                    auto idx = std::stoul(point);
+                    if (idx == 0 || idx >= overridden.points_count) {
+                        throw std::runtime_error("score_overrides point out of range: " + point);
+                    }
+                    overridden.point_scores[idx - 1] = score.get<int64_t>();
+                }
+            }
+
+            Solver solver(*input, args.meta);
+            solver.EnableTrace(request.value("trace", false));
+            if (request.contains("seed")) {
+                solver.SetSeed(request.at("seed").get<uint64_t>());
+            } else if (args.seed.has_value()) {
+                solver.SetSeed(*args.seed);
+            }
+            if (request.contains("warm_start")) {
+                auto warm_start = WarmStart{.route = request.at("warm_start").get<std::vector<InputData::points_type>>()};
+                if (request.contains("warm_start_neighbours")) {
+                    warm_start.neighbours = request.at("warm_start_neighbours").get<size_t>();
+                }
+                if (!solver.SetWarmStart(std::move(warm_start))) {
+                    throw std::runtime_error("warm_start route does not fit the instance");
+                }
+            }
+            solver.FirstStep();
+            auto result = solver.Solve(Solver::Clock::now() + std::chrono::seconds(args.time));
+
+            response.update(JsonParser::SolutionToJson(result.solution));
+            if (request.value("stats", false)) {
+                response["stats"] = JsonParser::StatisticsToJson(result.statistics);
+            }
+            if (request.value("trace", false)) {
+                response["trace"] = JsonParser::TraceToJson(result.trace);
+            }
+            response["instance_id"] = instance_id;
+        } catch (const std::exception &e) {
+            response["error"] = e.what();
+        }
+        return response;
+    }
+
+    void ServeConnection(int fd, std::shared_ptr<ResponseSink> sink, WorkerPool &pool, InstanceCache &cache,
+                         const ProgramArguments &args) {
+        std::string buffer;
+        char chunk[1 << 16];
+        while (true) {
+            auto res = read(fd, chunk, sizeof(chunk));
+            if (res <= 0) {
+                break;
+            }
+            buffer.append(chunk, res);
+
+            size_t begin = 0;
+            for (auto end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n', begin)) {
+                auto line = buffer.substr(begin, end - begin);
+                begin = end + 1;
+                if (line.empty()) {
+                    continue;
+                }
+                pool.Submit([line = std::move(line), sink, &cache, &args]() {
+                    sink->Write(HandleRequest(line, cache, args));
+                });
+            }
+            buffer.erase(0, begin);
+        }
+    }
+
+    int ServeStdin(WorkerPool &pool, InstanceCache &cache, const ProgramArguments &args) {
+        auto sink = std::make_shared<ResponseSink>(STDOUT_FILENO);
+
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            pool.Submit([line, sink, &cache, &args]() {
+                sink->Write(HandleRequest(line, cache, args));
+            });
+        }
+        return 0;
+    }
+
+    int ServeSocket(WorkerPool &pool, InstanceCache &cache, const ProgramArguments &args) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (args.daemon_socket.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Socket path is too long" << std::endl;
+            return -1;
+        }
+        std::strncpy(address.sun_path, args.daemon_socket.c_str(), sizeof(address.sun_path) - 1);
+
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0) {
+            std::cerr << "Can`t create socket: " << std::strerror(errno) << std::endl;
+            return -1;
+        }
+
+        unlink(args.daemon_socket.c_str());
+        if (bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(server, 16) < 0) {
+            std::cerr << "Can`t listen socket " << args.daemon_socket << ": " << std::strerror(errno) << std::endl;
+            close(server);
+            return -1;
+        }
+
+        Connections connections;
+        while (true) {
+            int client = accept(server, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "Can`t accept connection: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            connections.Start(client, [&pool, &cache, &args](int fd, std::shared_ptr<ResponseSink> sink) {
+                ServeConnection(fd, std::move(sink), pool, cache, args);
+            });
+        }
+
+        connections.Close();
+        close(server);
+        unlink(args.daemon_socket.c_str());
+        return -1;
+    }
+}
+
+int RunDaemon(const ProgramArguments &args) {
+    // закрытый читателем stdout тоже не должен убивать демон: запись просто вернет EPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+
+    InstanceCache cache(args.daemon_cache_size);
+    WorkerPool pool(args.daemon_workers);
+
+    if (args.daemon_socket == "-") {
+        return ServeStdin(pool, cache, args);
+    }
+    return ServeSocket(pool, cache, args);
+}
@@ -1,9 +1,18 @@
 #include "../include/first_step.hpp"
+#include "../include/timeline.hpp"
+#include "../include/batch_evaluator.hpp"
+#include "../include/cancellation.hpp"
 
 #include <algorithm>
 #include <iostream>
 #include <limits>
 #include <bitset>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FIRST_STEP_X86 1
+#endif
 
 constexpr size_t TOP_SOLUTIONS_COUNT = 7;
 
@@ -107,6 +116,435 @@ namespace {
         }
     }
 
+    /// кандидатов в блоке релаксации: блок соответствует одному слову строки посещений Layer::visited
+    constexpr size_t BLOCK_SIZE = 64;
+
+    /// Слой dp[load] в виде структуры массивов. Кандидаты всех вершин идут подряд по возрастанию
+    /// вершины и номера в dp[load][i], в том же порядке, в котором их перебирает релаксация.
+    /// Массивы дополнены до кратного BLOCK_SIZE, лишние кандидаты отсекаются маской блока.
+    struct Layer {
+        size_t count = 0;
+        std::vector<int32_t> vertex;
+        std::vector<uint32_t> index;
+        std::vector<score_type> value;
+        std::vector<score_type> time;
+        std::vector<score_type> distance;
+        /// те же метрики в double для векторной релаксации, значения - целые меньше 2^53
+        std::vector<double> value_lanes;
+        std::vector<double> time_lanes;
+        std::vector<double> distance_lanes;
+        /// строки посещений по вершинам: бит c % 64 слова visited[(v - 1) * words + c / 64] -
+        /// вершина v есть в пути кандидата c
+        std::vector<uint64_t> visited;
+        size_t words = 0;
+    };
+
+    /// метрики путей, которые прошли фильтр релаксации блока, по номеру кандидата в блоке
+    struct Block {
+        score_type value[BLOCK_SIZE];
+        score_type time[BLOCK_SIZE];
+        score_type distance[BLOCK_SIZE];
+    };
+
+    /// вершина, в которую идет релаксация слоя
+    struct Target {
+        int32_t vertex = 0;
+        score_type service = 0;
+        score_type score = 0;
+        /// столбец вершины в Relaxation::time_columns и distance_columns
+        const int32_t *time = nullptr;
+        const int32_t *distance = nullptr;
+        /// строка посещений вершины в Layer::visited, nullptr для склада
+        const uint64_t *visited = nullptr;
+    };
+
+    /// Релаксация блоков слоя в вершину. Переход i -> j считается для всех кандидатов блока сразу:
+    /// проверка посещения - маской из строки Layer::visited, время перехода - gather-ами из столбца
+    /// вершины j, ограничения и порог top-K - сравнениями лент. Наборы инструкций - как у BatchEvaluator,
+    /// если значения задачи не помещаются в int32 столбцы и 2^53, считается скалярно.
+    class Relaxation {
+    public:
+        Relaxation(const InputData &input, bool time_dependent) : input(input), time_dependent(time_dependent) {
+            points = input.points_count;
+            slices = time_dependent ? input.time_matrix.size() : 1;
+            backend = Fits() ? BatchEvaluator::Detect() : BatchEvaluator::Backend::Scalar;
+            if (backend == BatchEvaluator::Backend::Scalar) {
+                return;
+            }
+
+            // столбцы по вершине назначения: gather-ы релаксации в j читают S * n значений подряд
+            time_columns.resize(points * slices * points);
+            distance_columns.resize(points * points);
+            for (size_t slice = 0; slice < slices; ++slice) {
+                for (size_t from = 0; from < points; ++from) {
+                    for (size_t to = 0; to < points; ++to) {
+                        time_columns[(to * slices + slice) * points + from] =
+                                static_cast<int32_t>(input.time_matrix[slice][from][to]);
+                    }
+                }
+            }
+            for (size_t from = 0; from < points; ++from) {
+                for (size_t to = 0; to < points; ++to) {
+                    distance_columns[to * points + from] = static_cast<int32_t>(input.distance_matrix[from][to]);
+                }
+            }
+        }
+
+        bool vectorized() const {
+            return backend != BatchEvaluator::Backend::Scalar;
+        }
+
+        Target target(const Layer &layer, points_type j) const {
+            Target result;
+            result.vertex = j;
+            result.service = j == 0 ? 0 : input.point_service_times[j - 1];
+            result.score = j == 0 ? 0 : input.point_scores[j - 1];
+            if (vectorized()) {
+                result.time = time_columns.data() + j * slices * points;
+                result.distance = distance_columns.data() + j * points;
+            }
+            result.visited = j == 0 ? nullptr : layer.visited.data() + (j - 1) * layer.words;
+            return result;
+        }
+
+        /// Маска кандидатов блока [@begin, @begin + BLOCK_SIZE), которые не посещали вершину, дают путь
+        /// в пределах max_time и max_distance со значением больше @threshold; их метрики пишутся в @block
+        uint64_t relax(const Layer &layer, const Target &target, size_t begin, score_type threshold, Block &block) const;
+
+    private:
+        /// все значения помещаются в int32 столбцы, а суммы по пути точно представимы в double
+        bool Fits() const {
+            constexpr int64_t exact = int64_t{1} << 52;
+            if (static_cast<int64_t>(slices * points) > std::numeric_limits<int32_t>::max() ||
+                input.max_time >= exact || input.max_distance >= exact) {
+                return false;
+            }
+            int64_t total = 0;
+            for (size_t vertex = 0; vertex + 1 < points; ++vertex) {
+                total += std::abs(input.point_scores[vertex]) + std::abs(input.point_service_times[vertex]);
+                if (total >= exact) {
+                    return false;
+                }
+            }
+            for (size_t slice = 0; slice < slices; ++slice) {
+                for (const auto &row: input.time_matrix[slice]) {
+                    for (auto value: row) {
+                        if (value < 0 || value > std::numeric_limits<int32_t>::max()) {
+                            return false;
+                        }
+                    }
+                }
+            }
+            for (const auto &row: input.distance_matrix) {
+                for (auto value: row) {
+                    if (value < 0 || value > std::numeric_limits<int32_t>::max()) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        uint64_t RelaxScalar(const Layer &layer, const Target &target, size_t begin, score_type threshold,
+                             Block &block) const;
+
+        const InputData &input;
+        bool time_dependent;
+        size_t points;
+        size_t slices;
+        BatchEvaluator::Backend backend;
+        /// time_columns[(j * slices + s) * points + i] - время перехода i -> j в срезе s
+        std::vector<int32_t> time_columns;
+        /// distance_columns[j * points + i] - расстояние i -> j
+        std::vector<int32_t> distance_columns;
+    };
+
+    /// кандидаты блока, которые есть в слое и не посетили вершину
+    uint64_t ActiveLanes(const Layer &layer, const Target &target, size_t begin) {
+        const auto lanes = std::min(BLOCK_SIZE, layer.count - begin);
+        auto active = lanes == BLOCK_SIZE ? ~uint64_t{0} : (uint64_t{1} << lanes) - 1;
+        if (target.visited != nullptr) {
+            active &= ~target.visited[begin / BLOCK_SIZE];
+        }
+        return active;
+    }
+
+    uint64_t Relaxation::RelaxScalar(const Layer &layer, const Target &target, size_t begin, score_type threshold,
+                                     Block &block) const {
+        const auto j = static_cast<points_type>(target.vertex);
+        uint64_t survivors = 0;
+        for (auto active = ActiveLanes(layer, target, begin); active != 0; active &= active - 1) {
+            const auto lane = static_cast<size_t>(__builtin_ctzll(active));
+            const auto c = begin + lane;
+            const auto i = static_cast<points_type>(layer.vertex[c]);
+            if (i == j || layer.value[c] == FirstStepAnswer::default_value) {
+                continue;
+            }
+
+            score_type travel_time;
+            if (time_dependent) {
+                travel_time = input.get_time_dependent_cost(layer.time[c], i, j);
+            } else {
+                travel_time = input.time_matrix[0][i][j];
+            }
+            const auto value = layer.value[c] + target.score - travel_time;
+            const auto time = layer.time[c] + target.service + travel_time;
+            const auto distance = layer.distance[c] + input.distance_matrix[i][j];
+            if (time <= input.max_time && distance <= input.max_distance && value > threshold) {
+                block.value[lane] = value, block.time[lane] = time, block.distance[lane] = distance;
+                survivors |= uint64_t{1} << lane;
+            }
+        }
+        return survivors;
+    }
+
+#ifdef FIRST_STEP_X86
+    /// пути, прошедшие фильтр в лентах, переносятся в блок; все значения - точные целые
+    inline void StoreSurvivors(unsigned mask, size_t lane, const double *value, const double *time,
+                               const double *distance, Block &block) {
+        for (; mask != 0; mask &= mask - 1) {
+            const auto k = static_cast<size_t>(__builtin_ctz(mask));
+            block.value[lane + k] = static_cast<score_type>(value[k]);
+            block.time[lane + k] = static_cast<score_type>(time[k]);
+            block.distance[lane + k] = static_cast<score_type>(distance[k]);
+        }
+    }
+
+    /// блок по 4 кандидата в лентах AVX2
+    __attribute__((target("avx2")))
+    uint64_t RelaxAvx2(const Layer &layer, const Target &target, size_t begin, score_type threshold,
+                       int32_t points, int32_t slices, bool time_dependent, const InputData &input, Block &block) {
+        const auto duration = _mm256_set1_pd(static_cast<double>(InputData::time_duration));
+        const auto last_slice = _mm256_set1_pd(static_cast<double>(slices - 1));
+        const auto last_index = _mm_set1_epi32(slices - 1);
+        const auto points_lanes = _mm_set1_epi32(points);
+        const auto one = _mm_set1_epi32(1);
+        const auto zero = _mm256_setzero_pd();
+        const auto vertex_j = _mm_set1_epi32(target.vertex);
+        const auto service = _mm256_set1_pd(static_cast<double>(target.service));
+        const auto score = _mm256_set1_pd(static_cast<double>(target.score));
+        const auto max_time = _mm256_set1_pd(static_cast<double>(input.max_time));
+        const auto max_distance = _mm256_set1_pd(static_cast<double>(input.max_distance));
+        const auto bound = _mm256_set1_pd(static_cast<double>(threshold));
+        const auto invalid = _mm256_set1_pd(static_cast<double>(FirstStepAnswer::default_value));
+
+        const auto active = ActiveLanes(layer, target, begin);
+        uint64_t survivors = 0;
+        uint64_t relaxed = 0;
+        alignas(32) double value_lanes[4], time_lanes[4], distance_lanes[4];
+        for (size_t lane = 0; lane < BLOCK_SIZE; lane += 4) {
+            const auto c = begin + lane;
+            const auto vertex = _mm_loadu_si128(reinterpret_cast<const __m128i *>(layer.vertex.data() + c));
+            const auto same = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(vertex, vertex_j))));
+            const auto lanes = static_cast<unsigned>(active >> lane) & 0xFu & ~same;
+            if (lanes == 0) {
+                continue;
+            }
+            relaxed += __builtin_popcount(lanes);
+
+            const auto time = _mm256_loadu_pd(layer.time_lanes.data() + c);
+            const auto value = _mm256_loadu_pd(layer.value_lanes.data() + c);
+            const auto distance = _mm256_loadu_pd(layer.distance_lanes.data() + c);
+
+            __m256d travel;
+            if (time_dependent) {
+                // срез времени отправления, после последнего среза берется последний без интерполяции
+                auto slice = _mm256_floor_pd(_mm256_div_pd(time, duration));
+                const auto after_last = _mm256_cmp_pd(slice, last_slice, _CMP_GE_OQ);
+                slice = _mm256_min_pd(slice, last_slice);
+                const auto offset = _mm256_blendv_pd(_mm256_sub_pd(time, _mm256_mul_pd(slice, duration)),
+                                                     zero, after_last);
+                const auto slice_index = _mm256_cvtpd_epi32(slice);
+                const auto next_index = _mm_min_epi32(_mm_add_epi32(slice_index, one), last_index);
+                const auto current = _mm256_cvtepi32_pd(_mm_i32gather_epi32(
+                        target.time, _mm_add_epi32(_mm_mullo_epi32(slice_index, points_lanes), vertex), 4));
+                const auto next = _mm256_cvtepi32_pd(_mm_i32gather_epi32(
+                        target.time, _mm_add_epi32(_mm_mullo_epi32(next_index, points_lanes), vertex), 4));
+                const auto numerator = _mm256_add_pd(_mm256_mul_pd(current, _mm256_sub_pd(duration, offset)),
+                                                     _mm256_mul_pd(next, offset));
+                travel = _mm256_floor_pd(_mm256_div_pd(numerator, duration));
+            } else {
+                travel = _mm256_cvtepi32_pd(_mm_i32gather_epi32(target.time, vertex, 4));
+            }
+
+            const auto new_time = _mm256_add_pd(time, _mm256_add_pd(service, travel));
+            const auto new_value = _mm256_sub_pd(_mm256_add_pd(value, score), travel);
+            const auto new_distance = _mm256_add_pd(distance,
+                                                    _mm256_cvtepi32_pd(_mm_i32gather_epi32(target.distance, vertex, 4)));
+            auto good = _mm256_and_pd(_mm256_cmp_pd(new_time, max_time, _CMP_LE_OQ),
+                                      _mm256_cmp_pd(new_distance, max_distance, _CMP_LE_OQ));
+            good = _mm256_and_pd(good, _mm256_and_pd(_mm256_cmp_pd(new_value, bound, _CMP_GT_OQ),
+                                                     _mm256_cmp_pd(value, invalid, _CMP_NEQ_OQ)));
+            const auto mask = static_cast<unsigned>(_mm256_movemask_pd(good)) & lanes;
+            if (mask == 0) {
+                continue;
+            }
+
+            _mm256_store_pd(value_lanes, new_value);
+            _mm256_store_pd(time_lanes, new_time);
+            _mm256_store_pd(distance_lanes, new_distance);
+            StoreSurvivors(mask, lane, value_lanes, time_lanes, distance_lanes, block);
+            survivors |= static_cast<uint64_t>(mask) << lane;
+        }
+        if (time_dependent) {
+            InputData::cost_evaluations += relaxed;
+        }
+        return survivors;
+    }
+
+    /// то же по 8 кандидатов в лентах AVX-512
+    __attribute__((target("avx512f")))
+    uint64_t RelaxAvx512(const Layer &layer, const Target &target, size_t begin, score_type threshold,
+                         int32_t points, int32_t slices, bool time_dependent, const InputData &input, Block &block) {
+        const auto duration = _mm512_set1_pd(static_cast<double>(InputData::time_duration));
+        const auto last_slice = _mm512_set1_pd(static_cast<double>(slices - 1));
+        const auto last_index = _mm256_set1_epi32(slices - 1);
+        const auto points_lanes = _mm256_set1_epi32(points);
+        const auto one = _mm256_set1_epi32(1);
+        const auto zero = _mm512_setzero_pd();
+        const auto vertex_j = _mm256_set1_epi32(target.vertex);
+        const auto service = _mm512_set1_pd(static_cast<double>(target.service));
+        const auto score = _mm512_set1_pd(static_cast<double>(target.score));
+        const auto max_time = _mm512_set1_pd(static_cast<double>(input.max_time));
+        const auto max_distance = _mm512_set1_pd(static_cast<double>(input.max_distance));
+        const auto bound = _mm512_set1_pd(static_cast<double>(threshold));
+        const auto invalid = _mm512_set1_pd(static_cast<double>(FirstStepAnswer::default_value));
+
+        const auto active = ActiveLanes(layer, target, begin);
+        uint64_t survivors = 0;
+        uint64_t relaxed = 0;
+        alignas(64) double value_lanes[8], time_lanes[8], distance_lanes[8];
+        for (size_t lane = 0; lane < BLOCK_SIZE; lane += 8) {
+            const auto c = begin + lane;
+            const auto vertex = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(layer.vertex.data() + c));
+            const auto same = static_cast<unsigned>(
+                    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(vertex, vertex_j))));
+            const auto lanes = static_cast<__mmask8>(static_cast<unsigned>(active >> lane) & 0xFFu & ~same);
+            if (lanes == 0) {
+                continue;
+            }
+            relaxed += __builtin_popcount(lanes);
+
+            const auto time = _mm512_loadu_pd(layer.time_lanes.data() + c);
+            const auto value = _mm512_loadu_pd(layer.value_lanes.data() + c);
+            const auto distance = _mm512_loadu_pd(layer.distance_lanes.data() + c);
+
+            __m512d travel;
+            if (time_dependent) {
+                auto slice = _mm512_roundscale_pd(_mm512_div_pd(time, duration), _MM_FROUND_TO_NEG_INF);
+                const auto after_last = _mm512_cmp_pd_mask(slice, last_slice, _CMP_GE_OQ);
+                slice = _mm512_min_pd(slice, last_slice);
+                const auto offset = _mm512_mask_blend_pd(after_last, _mm512_sub_pd(time, _mm512_mul_pd(slice, duration)),
+                                                         zero);
+                const auto slice_index = _mm512_cvtpd_epi32(slice);
+                const auto next_index = _mm256_min_epi32(_mm256_add_epi32(slice_index, one), last_index);
+                const auto current = _mm512_cvtepi32_pd(_mm256_i32gather_epi32(
+                        target.time, _mm256_add_epi32(_mm256_mullo_epi32(slice_index, points_lanes), vertex), 4));
+                const auto next = _mm512_cvtepi32_pd(_mm256_i32gather_epi32(
+                        target.time, _mm256_add_epi32(_mm256_mullo_epi32(next_index, points_lanes), vertex), 4));
+                const auto numerator = _mm512_add_pd(_mm512_mul_pd(current, _mm512_sub_pd(duration, offset)),
+                                                     _mm512_mul_pd(next, offset));
+                travel = _mm512_roundscale_pd(_mm512_div_pd(numerator, duration), _MM_FROUND_TO_NEG_INF);
+            } else {
+                travel = _mm512_cvtepi32_pd(_mm256_i32gather_epi32(target.time, vertex, 4));
+            }
+
+            const auto new_time = _mm512_add_pd(time, _mm512_add_pd(service, travel));
+            const auto new_value = _mm512_sub_pd(_mm512_add_pd(value, score), travel);
+            const auto new_distance = _mm512_add_pd(distance,
+                                                    _mm512_cvtepi32_pd(_mm256_i32gather_epi32(target.distance, vertex, 4)));
+            auto mask = _mm512_mask_cmp_pd_mask(lanes, new_time, max_time, _CMP_LE_OQ);
+            mask = _mm512_mask_cmp_pd_mask(mask, new_distance, max_distance, _CMP_LE_OQ);
+            mask = _mm512_mask_cmp_pd_mask(mask, new_value, bound, _CMP_GT_OQ);
+            mask = _mm512_mask_cmp_pd_mask(mask, value, invalid, _CMP_NEQ_OQ);
+            if (mask == 0) {
+                continue;
+            }
+
+            _mm512_store_pd(value_lanes, new_value);
+            _mm512_store_pd(time_lanes, new_time);
+            _mm512_store_pd(distance_lanes, new_distance);
+            StoreSurvivors(mask, lane, value_lanes, time_lanes, distance_lanes, block);
+            survivors |= static_cast<uint64_t>(mask) << lane;
+        }
+        if (time_dependent) {
+            InputData::cost_evaluations += relaxed;
+        }
+        return survivors;
+    }
+#endif
+
+    uint64_t Relaxation::relax(const Layer &layer, const Target &target, size_t begin, score_type threshold,
+                               Block &block) const {
+#ifdef FIRST_STEP_X86
+        const auto points_count = static_cast<int32_t>(points);
+        const auto slices_count = static_cast<int32_t>(slices);
+        if (backend == BatchEvaluator::Backend::AVX512) {
+            return RelaxAvx512(layer, target, begin, threshold, points_count, slices_count, time_dependent, input, block);
+        }
+        if (backend == BatchEvaluator::Backend::AVX2) {
+            return RelaxAvx2(layer, target, begin, threshold, points_count, slices_count, time_dependent, input, block);
+        }
+#endif
+        return RelaxScalar(layer, target, begin, threshold, block);
+    }
+
+    /// Раскладывает dp[@load] в @layer. Пути кандидатов восстанавливаются по ссылкам на предков,
+    /// это O(load) на кандидата вместо обхода всего bitset.
+    template <size_t bitset_size>
+    void BuildLayer(const std::vector<std::vector<std::vector<Candidate<bitset_size>>>> &dp, points_type load,
+                    Layer &layer) {
+        const auto &states = dp[load];
+        const auto points_count = states.size();
+
+        layer.vertex.clear();
+        layer.index.clear();
+        layer.value.clear();
+        layer.time.clear();
+        layer.distance.clear();
+        for (points_type i = 0; i < points_count; ++i) {
+            if (i == 0 && load != 0) {
+                // из склада выходим только при загрузке 0
+                continue;
+            }
+            for (size_t idx = 0; idx < states[i].size(); ++idx) {
+                const auto &candidate = states[i][idx];
+                layer.vertex.push_back(i);
+                layer.index.push_back(static_cast<uint32_t>(idx));
+                layer.value.push_back(candidate.value);
+                layer.time.push_back(candidate.time);
+                layer.distance.push_back(candidate.distance);
+            }
+        }
+
+        layer.count = layer.vertex.size();
+        const auto padded = (layer.count + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+        layer.vertex.resize(padded, 0);
+        layer.index.resize(padded, 0);
+        layer.value.resize(padded, 0);
+        layer.time.resize(padded, 0);
+        layer.distance.resize(padded, 0);
+        layer.value_lanes.assign(layer.value.begin(), layer.value.end());
+        layer.time_lanes.assign(layer.time.begin(), layer.time.end());
+        layer.distance_lanes.assign(layer.distance.begin(), layer.distance.end());
+
+        layer.words = padded / BLOCK_SIZE;
+        layer.visited.assign((points_count > 0 ? points_count - 1 : 0) * layer.words, 0);
+        for (size_t c = 0; c < layer.count; ++c) {
+            const auto bit = uint64_t{1} << (c % BLOCK_SIZE);
+            const auto word = c / BLOCK_SIZE;
+            auto vertex = static_cast<points_type>(layer.vertex[c]);
+            auto idx = static_cast<size_t>(layer.index[c]);
+            for (auto path_load = static_cast<int64_t>(load); path_load > 0; --path_load) {
+                if (vertex != 0) {
+                    layer.visited[(vertex - 1) * layer.words + word] |= bit;
+                }
+                const auto &candidate = dp[path_load][vertex][idx];
+                vertex = candidate.last_vertex;
+                idx = candidate.candidate_idx;
+            }
+        }
+    }
 }
 
 template<size_t bitset_size, bool is_time_dependent>
@@ -115,8 +553,6 @@ std::vector<FirstStepAnswer> DoFirstStep(const InputData &input) {
     using score_type = FirstStepAnswer::score_type;
     using points_type = FirstStepAnswer::points_type;
 
-    auto max_dist = input.max_distance;
-    auto max_time = input.max_time;
     auto max_load = input.max_load;
     auto min_load = input.min_load;
     auto points_count = input.points_count;
@@ -139,70 +575,58 @@ std::vector<FirstStepAnswer> DoFirstStep(const InputData &input) {
     std::vector<Candidate<bitset_size>> candidates;
     candidates.reserve(TOP_SOLUTIONS_COUNT);
 
+    Relaxation relaxation(input, is_time_dependent);
+    Layer layer;
+    Block block;
+
     for (points_type cur_load = 0; cur_load <= max_load; ++cur_load) {
+        TimelineSpan span("first_step", "layer", cur_load);
         bool find_update_point = false;
-    
-        for (points_type j = 0; j < points_count; ++j) {
 
-            candidates.clear();
+        // все решения dp[cur_load] подряд, кандидаты с вершиной 0 берутся только при загрузке 0
+        BuildLayer(dp, cur_load, layer);
 
-            for (points_type i = 0; i < points_count; ++i) {
+        for (points_type j = 0; j < points_count; ++j) {
+            // при остановке ответы собираются из уже посчитанных состояний
+            if (Cancellation::Requested()) [[unlikely]] {
+                break;
+            }
 
-                if (i == 0 && cur_load != 0) [[unlikely]] {
-                    // хотим искать пути из начала только если загрузка 0
-                    continue;
-                }
+            candidates.clear();
+            const auto target = relaxation.target(layer, j);
+
+            for (size_t begin = 0; begin < layer.count; begin += BLOCK_SIZE) {
+                // порог top-K на начало блока: фильтр блока пропускает надмножество тех,
+                // кого примет IsCandidateGood, поэтому результат тот же, что у перебора по одному
+                const auto threshold = candidates.size() < TOP_SOLUTIONS_COUNT
+                        ? std::numeric_limits<score_type>::min() : candidates.back().value;
+
+                // проверки пути на посещение j, максимальное время, максимальную дистанцию и порог
+                for (auto survivors = relaxation.relax(layer, target, begin, threshold, block);
+                     survivors != 0; survivors &= survivors - 1) {
+                    const auto lane = static_cast<size_t>(__builtin_ctzll(survivors));
+                    const auto c = begin + lane;
+                    if (!IsCandidateGood(candidates, block.value[lane])) {
+                        continue;
+                    }
 
-                // делаем проверку:
-                // 1. вершины не совпали   
-                // 2. есть такой путь с cur_load вершинами, который заканчивается в i
-                if (i != j && !dp[cur_load][i].empty()) [[likely]] {
-
-                    // перебираем все решения из dp[cur_load][i]
-                    for (size_t candidate_idx = 0; candidate_idx < dp[cur_load][i].size(); ++candidate_idx) {
-                        const auto& prev_solution = dp[cur_load][i][candidate_idx];
-
-                        // 3. вершина j еще не была в пути
-                        if (prev_solution.value != FirstStepAnswer::default_value &&
-                            !prev_solution.IsVertexInPath(j)) [[likely]] {
-
-                            FirstStepAnswer::score_type travel_time;
-                            if constexpr (is_time_dependent) {
-                                travel_time = input.get_time_dependent_cost(prev_solution.time, i, j);
-                            } else {
-                                travel_time = input.time_matrix[0][i][j];
-                            }
-
-                            auto new_point_score = prev_solution.value + (j == 0 ? 0 : input.point_scores[j - 1]) -
-                                                   travel_time;
-                            auto new_point_time = prev_solution.time + (j == 0 ? 0 : input.point_service_times[j - 1]) +
-                                                  travel_time;
-                            auto new_point_dist = prev_solution.distance + input.distance_matrix[i][j];
-
-                            // проверки найденного пути на целевую функцию, максимальное время пути и максимальную дистанцию
-                            if (new_point_time <= max_time &&
-                                new_point_dist <= max_dist && 
-                                IsCandidateGood(candidates, new_point_score)
-                            ) {
-                                auto new_visited = prev_solution.visited;
-                                if (j > 0) {
-                                    new_visited.set(j - 1);
-                                }
-                                InsertTopCandidate(
-                                    candidates,
-                                    Candidate<bitset_size> {
-                                        .visited = std::move(new_visited),
-                                        .value = new_point_score,
-                                        .time = new_point_time,
-                                        .distance = new_point_dist,
-                                        .load = cur_load,
-                                        .candidate_idx = candidate_idx,
-                                        .last_vertex = i
-                                    }
-                                );
-                            }
-                        }
+                    const auto i = static_cast<points_type>(layer.vertex[c]);
+                    auto new_visited = dp[cur_load][i][layer.index[c]].visited;
+                    if (j > 0) {
+                        new_visited.set(j - 1);
                     }
+                    InsertTopCandidate(
+                        candidates,
+                        Candidate<bitset_size> {
+                            .visited = std::move(new_visited),
+                            .value = block.value[lane],
+                            .time = block.time[lane],
+                            .distance = block.distance[lane],
+                            .load = cur_load,
+                            .candidate_idx = layer.index[c],
+                            .last_vertex = i
+                        }
+                    );
                 }
             }
 
@@ -212,7 +636,7 @@ std::vector<FirstStepAnswer> DoFirstStep(const InputData &input) {
             }
         }
 
-        if (!find_update_point) {
+        if (!find_update_point || Cancellation::Requested()) {
             // выходим если не смогли обновить ни один из путей для cur_load + 1
             break;
         }
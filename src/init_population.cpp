@@ -1,119 +1,293 @@
 #include "../include/init_population.hpp"
+#include "../include/statistics.hpp"
+#include "../include/batch_evaluator.hpp"
+#include "../include/cancellation.hpp"
+
+#include <thread>
 
 #ifdef DEBUG
 #include "../utils/debug.h"
 #endif
 
 void PopulationInitializer::initialize_population(int path_size, int population_size, double beta, int alpha,
-                                                  const InputData &inputData, std::vector<Solution> &population) {
+                                                  const InputData &inputData, std::vector<Solution> &population,
+                                                  size_t threads, BatchEvaluator *evaluator) {
+
+    prepare(path_size, alpha, inputData);
+    threads = std::max<size_t>(threads, 1);
+
+    // хэши маршрутов популяции, отсортированы для бинарного поиска
+    std::vector<uint64_t> known;
+    known.reserve(population_size);
+    for (const auto &member: population) {
+        known.push_back(TourHash(member.tour));
+    }
+    std::sort(known.begin(), known.end());
+
+    const uint64_t base_seed = rng();
+    const size_t batch_size = threads > 1 ? threads * attempts_per_thread
+                                          : evaluator != nullptr ? BatchEvaluator::max_lanes : 1;
+    const bool evaluate = evaluator == nullptr;
+    std::vector<Attempt> batch(batch_size);
+    std::vector<Solution *> pending;
+    pending.reserve(batch_size);
+    // у потоков пачки свои рабочие буферы, списки соседей копируются из текущего объекта
+    std::vector<PopulationInitializer> workers(threads - 1, *this);
 
     size_t total_iterations = 0;
-    size_t random_iterations = 0;
-    size_t grasp_iterations = 0;
-    while (population.size() < population_size) {
+    // при остановке популяция остается неполной, в ней есть хотя бы решение первого шага
+    while (population.size() < population_size && total_iterations < max_iterations && !Cancellation::Requested()) {
+        // попыток не больше, чем недостает до полной популяции: все они будут просмотрены
+        const size_t count = std::min({batch_size, max_iterations - total_iterations,
+                                       population_size - population.size()});
 
-        if (total_iterations == max_iterations) {
-            break;
+        if (threads == 1) {
+            for (size_t i = 0; i < count; ++i) {
+                build_attempt(batch[i], Random::IndexSeed(base_seed, total_iterations + i), path_size, beta, alpha,
+                              inputData, known, evaluate);
+            }
+        } else {
+            // поток w строит попытки w, w + threads, ...; счетчики оценок потоков добавляются к текущему
+            std::vector<std::thread> pool;
+            std::vector<std::pair<uint64_t, uint64_t>> evaluations(threads - 1);
+            for (size_t worker = 1; worker < threads; ++worker) {
+                pool.emplace_back([&, worker]() {
+                    for (size_t i = worker; i < count; i += threads) {
+                        workers[worker - 1].build_attempt(batch[i], Random::IndexSeed(base_seed, total_iterations + i),
+                                                          path_size, beta, alpha, inputData, known, evaluate);
+                    }
+                    evaluations[worker - 1] = {InputData::path_evaluations, InputData::cost_evaluations};
+                });
+            }
+            for (size_t i = 0; i < count; i += threads) {
+                build_attempt(batch[i], Random::IndexSeed(base_seed, total_iterations + i), path_size, beta, alpha,
+                              inputData, known, evaluate);
+            }
+            for (auto &thread: pool) {
+                thread.join();
+            }
+            for (const auto &[path, cost]: evaluations) {
+                InputData::path_evaluations += path;
+                InputData::cost_evaluations += cost;
+            }
         }
 
-        Solution local_solution(0);
-        if (generate_random_double() <= beta) {
-#ifdef DEBUG
-            ++random_iterations;
-#endif
-            random_tour(local_solution, path_size, inputData);
-        } else {
-#ifdef DEBUG
-            ++grasp_iterations;
-#endif
-            grasp_tour(local_solution, path_size, alpha, inputData);
+        if (evaluator != nullptr) {
+            // построенные маршруты одной длины оцениваются пачкой в SIMD-лентах
+            pending.clear();
+            for (size_t i = 0; i < count; ++i) {
+                if (!batch[i].infeasible && !batch[i].duplicate) {
+                    pending.push_back(&batch[i].solution);
+                }
+            }
+            evaluator->evaluate(pending.data(), pending.size());
         }
-        ++total_iterations;
 
-        if (local_solution.time <= inputData.max_time && local_solution.distance <= inputData.max_distance) {
-            // Проверяем, что такого решения еще нет в популяции
-            if (std::any_of(population.cbegin(), population.cend(),
-                             [&local_solution](const auto &existed_solution) { return existed_solution == local_solution; })) {
+        for (size_t i = 0; i < count && population.size() < population_size; ++i) {
+            ++total_iterations;
+            auto &attempt = batch[i];
+            auto &local_solution = attempt.solution;
+
+            if (attempt.infeasible) {
+                continue;
+            }
+
+            // совпадение хэшей считаем повтором, вероятность коллизии разных маршрутов ~2^-64
+            if (attempt.duplicate || std::binary_search(known.begin(), known.end(), attempt.hash)) {
 #ifdef DEBUG
                 std::cout << "Can`t add dublicate tour to population\n";
 #endif
+                ++LocalStatistics().dedup_rejections;
                 continue;
             }
+
+            if (local_solution.time <= inputData.max_time && local_solution.distance <= inputData.max_distance) {
 #ifdef DEBUG
-            std::cout << "Added tour to population:\n";
-            std::cout << local_solution << std::endl;
+                std::cout << "Added tour to population:\n";
+                std::cout << local_solution << std::endl;
 #endif
-            population.emplace_back(std::move(local_solution));
+                known.insert(std::upper_bound(known.begin(), known.end(), attempt.hash), attempt.hash);
+                population.emplace_back(std::move(local_solution));
+            }
         }
     }
 
 #ifdef DEBUG
     std::cout << "Generated " << population.size() << " tours\n";
-    std::cout << "Random iterations: " << random_iterations << "\nGrasp iterations: " << grasp_iterations << "\n";
     std::cout << "Total iterations: " << total_iterations << "\n";
     std::cout << "Population size: " << population.size() << std::endl;
 #endif
 }
 
-void PopulationInitializer::random_tour(Solution &solution, int n, const InputData &input) {
-    solution.tour.clear();
-    solution.tour.reserve(n);
-    // добавляем все кроме депо
-    for (int i = 1; i < n - 1; i++) {
-        solution.tour.push_back(i);
+void PopulationInitializer::build_attempt(Attempt &attempt, uint64_t seed, int path_size, double beta, int alpha,
+                                          const InputData &inputData, const std::vector<uint64_t> &known,
+                                          bool evaluate) {
+    rng = Random::Generator(seed);
+    auto &solution = attempt.solution;
+    if (generate_random_double() <= beta) {
+        random_path(solution.tour, path_size);
+    } else if (!grasp_path(solution.tour, path_size, alpha, inputData, true)) {
+        attempt.infeasible = true;
+        return;
     }
+    attempt.infeasible = false;
 
-    std::shuffle(solution.tour.begin(), solution.tour.end(), rng);
-    // добавление начального и конечного депо
-    solution.tour.insert(solution.tour.begin(), 0);
-    solution.tour.push_back(0);
+    // повтор маршрута из популяции отбрасываем до полной оценки
+    attempt.hash = TourHash(solution.tour);
+    attempt.duplicate = std::binary_search(known.begin(), known.end(), attempt.hash);
+    if (attempt.duplicate || !evaluate) {
+        return;
+    }
+
+    auto [distance, time, score] = inputData.get_path_time_distance_score(solution.tour);
+    solution.distance = distance, solution.time = time, solution.score = score;
+}
 
+void PopulationInitializer::prepare(int n, int alpha, const InputData &input) {
+    // вершины маршрута - 0..n-2, кандидаты - 1..n-2
+    const auto vertexes = static_cast<size_t>(std::max(n - 1, 0));
+    const auto customers = vertexes > 0 ? vertexes - 1 : 0;
+    neighbours_count = std::max(min_neighbours, static_cast<size_t>(2 * candidates_per_rcl_slot * alpha));
+    // короткие маршруты перебираются целиком
+    const bool use_neighbours = neighbours_count < customers;
+    neighbours.resize(use_neighbours ? vertexes * neighbours_count : 0);
+    min_travel.resize(vertexes * vertexes);
+
+    std::vector<int64_t> total(vertexes);
+    std::vector<std::pair<int64_t, Vertex>> ranked;
+    ranked.reserve(customers);
+    for (Vertex from = 0; from < vertexes; ++from) {
+        // сумма по срезам упорядочивает так же, как среднее; строки срезов читаются подряд
+        auto *minimum = &min_travel[from * vertexes];
+        std::fill(total.begin(), total.end(), 0);
+        std::copy_n(input.time_matrix[0][from].begin(), vertexes, minimum);
+        for (const auto &slice: input.time_matrix) {
+            const auto &row = slice[from];
+            for (Vertex to = 0; to < vertexes; ++to) {
+                total[to] += row[to];
+                minimum[to] = std::min(minimum[to], row[to]);
+            }
+        }
+
+        if (!use_neighbours) {
+            continue;
+        }
+        ranked.clear();
+        for (Vertex to = 1; to < vertexes; ++to) {
+            if (to != from) {
+                ranked.emplace_back(total[to], to);
+            }
+        }
+        // neighbours_count < customers, поэтому кандидатов в ranked хватает
+        std::partial_sort(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(neighbours_count), ranked.end());
+        for (size_t k = 0; k < neighbours_count; ++k) {
+            neighbours[from * neighbours_count + k] = ranked[k].second;
+        }
+    }
+    neighbours_points = use_neighbours ? n : 0;
+    bounds_points = n;
+}
+
+void PopulationInitializer::random_tour(Solution &solution, int n, const InputData &input) {
+    random_path(solution.tour, n);
     auto [distance, time, score] = input.get_path_time_distance_score(solution.tour);
     solution.distance = distance, solution.time = time, solution.score = score;
 }
 
 void PopulationInitializer::grasp_tour(Solution &solution, int n, int alpha, const InputData &input) {
-    std::vector<bool> visited(n - 1, false);
-    visited[0] = true;
+    grasp_path(solution.tour, n, alpha, input, false);
+    auto [distance, time, score] = input.get_path_time_distance_score(solution.tour);
+    solution.distance = distance, solution.time = time, solution.score = score;
+}
 
-    solution.tour.resize(n);
-    solution.tour[0] = 0;
-    solution.time = 0;
-    solution.distance = 0;
-    solution.score = 0;
+void PopulationInitializer::random_path(Path &tour, int n) {
+    tour.clear();
+    tour.reserve(n);
+    // добавляем все кроме депо
+    for (int i = 1; i < n - 1; i++) {
+        tour.push_back(i);
+    }
+
+    std::shuffle(tour.begin(), tour.end(), rng);
+    // добавление начального и конечного депо
+    tour.insert(tour.begin(), 0);
+    tour.push_back(0);
+}
+
+bool PopulationInitializer::grasp_path(Path &tour, int n, int alpha, const InputData &input, bool stop_infeasible) {
+    visited.assign(n - 1, 0);
+    visited[0] = 1;
 
-    std::vector<std::pair<int64_t, decltype(solution.tour)::value_type >> candidates;
+    tour.resize(n);
+    tour[0] = 0;
+    int64_t time = 0;
+
+    const bool use_neighbours = neighbours_points == n;
+    stop_infeasible = stop_infeasible && bounds_points == n;
+    // нижняя оценка времени и расстояние построенной части маршрута
+    int64_t time_bound = 0;
+    int64_t distance = 0;
+    const auto wanted = static_cast<size_t>(candidates_per_rcl_slot * alpha);
     candidates.reserve(n);
 
     // проходимся по всем кроме депо
     for (int i = 1; i < n - 1; i++) {
-        auto last_vertex = solution.tour[i - 1];
+        auto last_vertex = tour[i - 1];
+        const auto unvisited = static_cast<size_t>(n - 1 - i);
 
         candidates.clear();
-        // не берем в учет депо
-        for (uint32_t j = 1; j < n - 1; j++) {
-            if (!visited[j]) {
-                auto time = input.get_time_dependent_cost(solution.time, last_vertex, j);
-                candidates.emplace_back(time, j);
+        if (use_neighbours) {
+            // ближайшие по среднему времени непосещенные соседи
+            const auto *list = &neighbours[last_vertex * neighbours_count];
+            for (size_t k = 0; k < neighbours_count && candidates.size() < wanted; ++k) {
+                const auto vertex = list[k];
+                if (!visited[vertex]) {
+                    visited[vertex] = 2;
+                    candidates.emplace_back(input.get_time_dependent_cost(time, last_vertex, vertex), vertex);
+                }
+            }
+            for (const auto &[cost, vertex]: candidates) {
+                visited[vertex] = 0;
+            }
+        }
+        if (candidates.size() < std::min(static_cast<size_t>(alpha), unvisited)) {
+            // соседей в списке не хватило на RCL - перебираем всех непосещенных
+            candidates.clear();
+            // не берем в учет депо
+            for (uint32_t j = 1; j < n - 1; j++) {
+                if (!visited[j]) {
+                    candidates.emplace_back(input.get_time_dependent_cost(time, last_vertex, j), j);
+                }
             }
         }
 
-        sort(candidates.begin(), candidates.end());
-        int rcl_size = std::min(alpha, static_cast<int>(candidates.size()));
+        // RCL - alpha лучших кандидатов, упорядоченных как при полной сортировке
+        const auto rcl_size = std::min(static_cast<size_t>(alpha), candidates.size());
+        const auto rcl_end = candidates.begin() + static_cast<std::ptrdiff_t>(rcl_size);
+        if (rcl_size < candidates.size()) {
+            std::nth_element(candidates.begin(), rcl_end, candidates.end());
+        }
+        std::sort(candidates.begin(), rcl_end);
         // потому что мы не можем выбирать депо пока есть еще непосещенные вершины
-        int next_vertex = candidates[ rcl_size == 1 ? 0 : generate_random_int(0, rcl_size - 1)].second;
+        const auto &[travel, next_vertex] =
+                candidates[rcl_size == 1 ? 0 : generate_random_int(0, static_cast<int>(rcl_size) - 1)];
 
-        solution.distance += input.distance_matrix[last_vertex][next_vertex];
-        solution.time += input.get_time_dependent_cost(solution.time, last_vertex, next_vertex);
-        solution.tour[i] = next_vertex;
+        time += travel;
+        tour[i] = next_vertex;
+        visited[next_vertex] = 1;
 
-        visited[next_vertex] = true;
+        if (stop_infeasible) {
+            time_bound += min_travel[last_vertex * (n - 1) + next_vertex] + input.point_service_times[next_vertex - 1];
+            distance += input.distance_matrix[last_vertex][next_vertex];
+            if (time_bound > input.max_time || distance > input.max_distance) {
+                return false;
+            }
+        }
     }
 
     // добавление конечного депо
-    solution.tour[n - 1] = 0;
-    auto [distance, time, score] = input.get_path_time_distance_score(solution.tour);
-    solution.distance = distance, solution.time = time, solution.score = score;
+    tour[n - 1] = 0;
+    return true;
 }
 
 double PopulationInitializer::generate_random_double() {
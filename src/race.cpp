@@ -0,0 +1,120 @@
+#include "../include/race.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+Race::Race(size_t threads, size_t first_rung) : first_rung(first_rung), lanes(threads) {}
+
+bool Race::offer(int64_t score) {
+    auto current = best.load(std::memory_order_relaxed);
+    while (score > current) {
+        if (best.compare_exchange_weak(current, score, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Race::hopeless(size_t thread, int64_t upper_bound) {
+    if (upper_bound > incumbent()) [[likely]] {
+        return false;
+    }
+    std::lock_guard lock(mutex);
+    lanes[thread].outcome.hopeless = true;
+    return true;
+}
+
+bool Race::advance(size_t thread, uint64_t iteration, int64_t score, std::chrono::steady_clock::time_point deadline) {
+    // ступени на итерациях first_rung * 2^k
+    if (first_rung == 0 || iteration < first_rung || iteration % first_rung != 0) [[likely]] {
+        return true;
+    }
+    const auto multiple = iteration / first_rung;
+    if ((multiple & (multiple - 1)) != 0) {
+        return true;
+    }
+    int64_t rung = 0;
+    while ((uint64_t{1} << rung) < multiple) {
+        ++rung;
+    }
+
+    std::unique_lock lock(mutex);
+    auto &lane = lanes[thread];
+    lane.rung = rung, lane.score = score;
+    decide(rung);
+    // по дедлайну поток продолжает, поиск сам остановится по времени
+    decided.wait_until(lock, deadline, [this, rung]() { return decided_rung >= rung; });
+    return !lane.outcome.eliminated;
+}
+
+int Race::patience(size_t thread) const {
+    if (first_rung == 0) {
+        return 1;
+    }
+    std::lock_guard lock(mutex);
+    return 1 << std::min<uint32_t>(lanes[thread].outcome.rungs, 4);
+}
+
+void Race::finish(size_t thread) {
+    std::lock_guard lock(mutex);
+    lanes[thread].active = false;
+    // ушедший поток больше не задерживает ждущих на ближайшей ступени
+    decide(decided_rung + 1);
+}
+
+Race::Outcome Race::outcome(size_t thread) const {
+    std::lock_guard lock(mutex);
+    return lanes[thread].outcome;
+}
+
+void Race::decide(int64_t rung) {
+    std::vector<size_t> waiting;
+    for (size_t i = 0; i < lanes.size(); ++i) {
+        if (!lanes[i].active) {
+            continue;
+        }
+        if (lanes[i].rung < rung) {
+            return;
+        }
+        waiting.push_back(i);
+    }
+    if (waiting.empty()) {
+        return;
+    }
+
+    // лучшая половина по score, при равенстве - меньший номер потока
+    std::stable_sort(waiting.begin(), waiting.end(),
+                     [this](size_t lhs, size_t rhs) { return lanes[lhs].score > lanes[rhs].score; });
+    const auto survivors = (waiting.size() + 1) / 2;
+    for (size_t k = 0; k < waiting.size(); ++k) {
+        auto &lane = lanes[waiting[k]];
+        if (k < survivors) {
+            lane.outcome.rungs = static_cast<uint32_t>(rung + 1);
+        } else {
+            lane.outcome.eliminated = true;
+            lane.active = false;
+        }
+    }
+    decided_rung = rung;
+    decided.notify_all();
+}
+
+int64_t ScoreUpperBound(const InputData &input) {
+    const auto points = static_cast<size_t>(input.points_count);
+    int64_t bound = std::accumulate(input.point_scores.begin(), input.point_scores.end(), int64_t{0});
+    if (points < 2) {
+        return bound;
+    }
+    for (size_t to = 0; to < points; ++to) {
+        auto arrival = std::numeric_limits<int64_t>::max();
+        for (const auto &slice: input.time_matrix) {
+            for (size_t from = 0; from < points; ++from) {
+                if (from != to) {
+                    arrival = std::min(arrival, slice[from][to]);
+                }
+            }
+        }
+        bound -= arrival;
+    }
+    return bound;
+}
@@ -0,0 +1,481 @@
+#include "../include/solver.hpp"
+
+#include "../include/algorithm.hpp"
+#include "../include/checkpoint.hpp"
+#include "../include/race.hpp"
+#include "../include/timeline.hpp"
+#include "../include/validation.hpp"
+
+#ifdef DEBUG
+#include "../utils/debug.h"
+#endif
+
+#include <iostream>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <numeric>
+#include <optional>
+#include <algorithm>
+
+namespace {
+    using points_type = FirstStepAnswer::points_type;
+
+    uint64_t elapsed_us(Solver::Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Solver::Clock::now() - start).count();
+    }
+
+    std::vector<FirstStepAnswer> RunFirstStep(const InputData& input) {
+        // нужно чтобы нам bitset был хоть сколько-то гибким
+        if (input.points_count < 128) {
+            return DoFirstStep<128, true>(input);
+        } else if (input.points_count < 256) {
+            return DoFirstStep<256, true>(input);
+        } else if (input.points_count < 512) {
+            return DoFirstStep<512, true>(input);
+        }
+        return DoFirstStep<std::numeric_limits<InputData::points_type>::max(), true>(input);
+    }
+
+    // склад, вершины маршрута и по @neighbours ближайших к каждой из них по минимуму времени перехода
+    // по срезам, по возрастанию номеров
+    std::vector<points_type> WarmStartPoints(const InputData& input, const std::vector<points_type>& route,
+                                             size_t neighbours) {
+        std::vector<uint8_t> taken(input.points_count, 0);
+        taken[0] = 1;
+        std::vector<std::pair<int64_t, points_type>> nearest;
+        for (auto from: route) {
+            taken[from] = 1;
+            nearest.clear();
+            for (points_type to = 1; to < input.points_count; ++to) {
+                if (to == from) {
+                    continue;
+                }
+                auto travel = std::numeric_limits<int64_t>::max();
+                for (const auto& slice: input.time_matrix) {
+                    travel = std::min(travel, slice[from][to]);
+                }
+                nearest.emplace_back(travel, to);
+            }
+            const auto count = std::min(neighbours, nearest.size());
+            std::partial_sort(nearest.begin(), nearest.begin() + count, nearest.end());
+            for (size_t k = 0; k < count; ++k) {
+                taken[nearest[k].second] = 1;
+            }
+        }
+
+        std::vector<points_type> points;
+        for (points_type v = 0; v < input.points_count; ++v) {
+            if (taken[v]) {
+                points.push_back(v);
+            }
+        }
+        return points;
+    }
+
+    // @sub_input - подзадача на вершинах @points ответа первого шага
+    Solution Optimize(const FirstStepAnswer& firstStepAnswer, const std::vector<points_type>& points,
+                      const InputData& sub_input, Context& ctx) {
+
+        // новый маршрут будет иметь вид 0 -> 1 -> 2 -> ... -> n -> 0
+        std::vector<points_type> tour(firstStepAnswer.vertexes.size());
+        std::iota(tour.begin(), tour.end() - 1, 0);
+        tour.back() = 0;
+
+        Solution solution(std::move(tour), firstStepAnswer.distance, firstStepAnswer.time, firstStepAnswer.value);
+
+        if (ctx.on_incumbent) {
+            // наружу решение отдается в исходной нумерации
+            ctx.on_incumbent = [&points, publish = std::move(ctx.on_incumbent)](const Solution &incumbent) {
+                auto mapped = incumbent;
+                for (auto& vertex: mapped.tour) {
+                    vertex = points[vertex];
+                }
+                publish(mapped);
+            };
+        }
+
+        auto answer = applyTspTDPDP(std::move(solution), sub_input, ctx);
+
+        // возвращаемся к исходной нумерации вершин
+        for (auto& vertex: answer.tour) {
+            vertex = points[vertex];
+        }
+
+        return answer;
+    }
+}
+
+bool Solver::SetWarmStart(WarmStart warm_start) {
+    const auto& input = instance();
+    auto& route = warm_start.route;
+    if (route.size() < 2 || route.front() != 0 || route.back() != 0) {
+        std::cerr << "Warm start route must start and end at the depot" << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> seen(input.points_count, 0);
+    for (size_t i = 1; i + 1 < route.size(); ++i) {
+        if (route[i] == 0 || route[i] >= input.points_count || seen[route[i]]) {
+            std::cerr << "Warm start route has a point out of range or visited twice: " << route[i] << std::endl;
+            return false;
+        }
+        seen[route[i]] = 1;
+    }
+
+    auto [distance, time, score] = input.get_path_time_distance_score(route);
+    size_t dropped = 0;
+    // пока маршрут недопустим, выбрасываем вершину, без которой нарушение меньше всего,
+    // при равенстве - с большим score оставшегося маршрута
+    while ((time > input.max_time || distance > input.max_distance) && route.size() > 2) {
+        auto violation = [&input](int64_t d, int64_t t) {
+            return static_cast<double>(std::max<int64_t>(t - input.max_time, 0)) / std::max<int64_t>(input.max_time, 1) +
+                   static_cast<double>(std::max<int64_t>(d - input.max_distance, 0)) / std::max<int64_t>(input.max_distance, 1);
+        };
+        std::optional<std::tuple<double, int64_t, size_t>> best;
+        auto candidate = route;
+        for (size_t i = 1; i + 1 < route.size(); ++i) {
+            candidate.erase(candidate.begin() + static_cast<std::ptrdiff_t>(i));
+            auto [d, t, v] = input.get_path_time_distance_score(candidate);
+            auto key = std::make_tuple(violation(d, t), -v, i);
+            if (!best.has_value() || key < *best) {
+                best = key;
+            }
+            candidate.insert(candidate.begin() + static_cast<std::ptrdiff_t>(i), route[i]);
+        }
+        route.erase(route.begin() + static_cast<std::ptrdiff_t>(std::get<2>(*best)));
+        std::tie(distance, time, score) = input.get_path_time_distance_score(route);
+        ++dropped;
+    }
+
+    warm_answer = FirstStepAnswer{.value = score, .distance = distance, .time = time, .vertexes = std::move(route)};
+    warm_neighbours = warm_start.neighbours;
+    statistics.warm_start = true;
+    statistics.warm_start_score = score;
+    statistics.warm_start_dropped = dropped;
+    return true;
+}
+
+bool Solver::ApplySliceDelta(const SliceDelta &delta) {
+    const auto points_count = static_cast<size_t>(instance().points_count);
+    for (const auto& slice: delta.slices) {
+        const bool fits = slice.index < instance().time_matrix.size() && slice.times.size() == points_count &&
+                          std::all_of(slice.times.begin(), slice.times.end(),
+                                      [points_count](const auto& row) { return row.size() == points_count; });
+        if (!fits) {
+            std::cerr << "Slice update does not fit the instance: " << slice.index << std::endl;
+            return false;
+        }
+    }
+
+    if (!updated.has_value()) {
+        updated = input;
+    }
+    for (const auto& slice: delta.slices) {
+        updated->time_matrix[slice.index] = slice.times;
+    }
+
+    // в подзадачах потоков меняются только замененные срезы, остальные данные остаются
+    for (auto& state: states) {
+        for (const auto& slice: delta.slices) {
+            if (state.points.empty()) {
+                break;
+            }
+            auto& times = state.sub_input.time_matrix[slice.index];
+            for (size_t from = 0; from < state.points.size(); ++from) {
+                for (size_t to = 0; to < state.points.size(); ++to) {
+                    times[from][to] = slice.times[state.points[from]][state.points[to]];
+                }
+            }
+        }
+    }
+
+    RescoreAnswers();
+    ++statistics.slice_updates;
+    return true;
+}
+
+void Solver::RescoreAnswers() {
+    auto rescore = [this](FirstStepAnswer& answer) {
+        std::tie(answer.distance, answer.time, answer.value) = instance().get_path_time_distance_score(answer.vertexes);
+    };
+    for (auto& answer: first_step_answers) {
+        rescore(answer);
+    }
+    if (warm_answer.has_value()) {
+        rescore(*warm_answer);
+    }
+    if (!first_step_answers.empty()) {
+        statistics.first_step_score = std::max_element(first_step_answers.begin(), first_step_answers.end())->value;
+    }
+}
+
+bool Solver::Resume(const std::string &path) {
+    Checkpoint checkpoint;
+    if (!CheckpointFile::Read(path, instance().points_count, checkpoint)) {
+        return false;
+    }
+    if (checkpoint.fingerprint != CheckpointFile::Fingerprint(instance())) {
+        std::cerr << "Checkpoint was written for another instance" << std::endl;
+        return false;
+    }
+    std::vector<SearchState> resumed(checkpoint.answers.size());
+    for (size_t i = 0; i < checkpoint.answers.size(); ++i) {
+        const auto& vertexes = checkpoint.answers[i].vertexes;
+        auto error = Validation::CheckTour(instance(), vertexes);
+        // маршруты популяции в нумерации подзадачи на вершинах ответа без конечного склада,
+        // подзадача сразу остается в состоянии потока, как ее построил бы Solve
+        if (error.empty() && !checkpoint.populations[i].empty()) {
+            auto& state = resumed[i];
+            state.points.assign(vertexes.begin(), vertexes.end() - 1);
+            state.sub_input = instance().restrict_to(state.points);
+            for (const auto& solution: checkpoint.populations[i]) {
+                error = solution.tour.size() != vertexes.size() ? "population tour size differs from the answer"
+                                                                : Validation::CheckTour(state.sub_input, solution.tour);
+                if (!error.empty()) {
+                    break;
+                }
+            }
+            state.population = std::move(checkpoint.populations[i]);
+        }
+        if (!error.empty()) {
+            std::cerr << "Checkpoint is damaged: answer " << i << " does not fit the instance: " << error << std::endl;
+            return false;
+        }
+    }
+
+    // Срезы времени в отпечаток не входят и могли измениться. Поток перебирает только порядок вершин
+    // своего ответа, поэтому ответ, у которого ни маршрут, ни решения популяции больше не укладываются
+    // в ограничения, отбрасывается
+    auto feasible = [](const InputData& problem, const std::vector<points_type>& tour) {
+        auto [distance, time, score] = problem.get_path_time_distance_score(tour);
+        return time <= problem.max_time && distance <= problem.max_distance;
+    };
+    std::vector<FirstStepAnswer> answers;
+    std::vector<SearchState> kept;
+    for (size_t i = 0; i < checkpoint.answers.size(); ++i) {
+        const auto& state = resumed[i];
+        if (feasible(instance(), checkpoint.answers[i].vertexes) ||
+            std::any_of(state.population.begin(), state.population.end(),
+                        [&](const auto& solution) { return feasible(state.sub_input, solution.tour); })) {
+            answers.push_back(std::move(checkpoint.answers[i]));
+            kept.push_back(std::move(resumed[i]));
+        }
+    }
+
+    start = Clock::now();
+    seed = checkpoint.seed;
+    generation = checkpoint.generation + 1;
+    resumed_elapsed_us = checkpoint.elapsed_us;
+    statistics.checkpoint_generation = generation;
+    if (answers.empty()) {
+        // потраченное время и seed продолжения остаются, а наборы вершин строятся заново по новым срезам
+        std::cerr << "Checkpoint answers do not fit the current time slices, first step is repeated" << std::endl;
+        return true;
+    }
+
+    // метрики из файла посчитаны по старым срезам
+    states = std::move(kept);
+    first_step_answers = std::move(answers);
+    first_step_done = true;
+    RescoreAnswers();
+    statistics.first_step_answers = first_step_answers.size();
+    return true;
+}
+
+const std::vector<FirstStepAnswer>& Solver::FirstStep() {
+    if (first_step_done) {
+        return first_step_answers;
+    }
+
+    start = Clock::now();
+    auto cost_evaluations = InputData::cost_evaluations;
+    TimelineSpan span("solver", "FirstStep");
+
+    if (!warm_answer.has_value() || !warm_neighbours.has_value()) {
+        first_step_answers = RunFirstStep(instance());
+    } else if (*warm_neighbours > 0) {
+        // DP только по окрестности прошлого маршрута, ответы переводятся в исходную нумерацию
+        const auto points = WarmStartPoints(instance(), warm_answer->vertexes, *warm_neighbours);
+        first_step_answers = RunFirstStep(instance().restrict_to(points));
+        for (auto& answer: first_step_answers) {
+            for (auto& vertex: answer.vertexes) {
+                vertex = points[vertex];
+            }
+        }
+    }
+    // маршрут теплого старта первый: среди равных ему наборов вершин поток остается у него
+    warm_first = warm_answer.has_value() && warm_answer->vertexes.size() > 2;
+    if (warm_first) {
+        first_step_answers.insert(first_step_answers.begin(), *warm_answer);
+    }
+
+    first_step_done = true;
+    statistics.first_step_us = elapsed_us(start);
+    statistics.first_step_cost_evaluations = InputData::cost_evaluations - cost_evaluations;
+    statistics.first_step_answers = first_step_answers.size();
+    if (!first_step_answers.empty()) {
+        statistics.first_step_score = std::max_element(first_step_answers.begin(), first_step_answers.end())->value;
+    }
+
+    return first_step_answers;
+}
+
+SolverResult Solver::Solve(Clock::time_point deadline) {
+    const auto& answers = FirstStep();
+
+    auto second_step_start = Clock::now();
+    statistics.seed = seed;
+    SolverResult result;
+
+    if (answers.empty()) {
+        result.statistics = statistics;
+        return result;
+    }
+
+    // одинаковые наборы вершин оптимизируются один раз, поток остается у первого из них
+    Race race(answers.size(), params.racing_rung);
+    // лучший score прерванного запуска не предлагается гонке: при других срезах он может быть недостижим,
+    // переоцененные популяции сами отдают свои настоящие score
+    published_score = std::numeric_limits<int64_t>::min();
+    std::vector<size_t> launched;
+    statistics.duplicate_answers = 0;
+    for (size_t i = 0; i < answers.size(); ++i) {
+        if (std::any_of(launched.begin(), launched.end(), [&](size_t j) { return answers[j] == answers[i]; })) {
+            ++statistics.duplicate_answers;
+            race.finish(i);
+        } else {
+            launched.push_back(i);
+        }
+    }
+
+    states.resize(answers.size());
+    std::optional<CheckpointWriter> checkpoints;
+    if (!checkpoint_path.empty()) {
+        Checkpoint base{.fingerprint = CheckpointFile::Fingerprint(instance()),
+                        .seed = seed,
+                        .generation = generation,
+                        .elapsed_us = resumed_elapsed_us,
+                        .answers = answers};
+        for (const auto& state: states) {
+            base.populations.push_back(state.population);
+        }
+        checkpoints.emplace(checkpoint_path, checkpoint_interval, std::move(base), race, second_step_start);
+    }
+    // продолжение с чекпоинта получает свои seed потоков, чтобы не повторять случайные решения прерванного запуска
+    const auto run_seed = generation > 0 ? Random::IndexSeed(seed, generation) : seed;
+    std::vector<std::optional<Solution>> solutions(answers.size());
+    std::vector<SearchStatistics> search_statistics(answers.size());
+    std::vector<std::vector<IterInfo>> traces(answers.size());
+    statistics.threads.assign(launched.size(), ThreadStatistics{});
+    std::vector<std::thread> threads;
+    threads.reserve(launched.size());
+
+    for (size_t slot = 0; slot < launched.size(); ++slot) {
+        const auto i = launched[slot];
+        threads.emplace_back([this, &answers, &solutions, &search_statistics, &traces, &race, &checkpoints, run_seed,
+                              deadline, i, slot]() {
+            auto thread_start = Clock::now();
+            LocalStatistics() = SearchStatistics{};
+            auto path_evaluations = InputData::path_evaluations;
+            auto cost_evaluations = InputData::cost_evaluations;
+
+            auto ctx = Context {
+                .params = params,
+                .deadline = deadline,
+                .seed = Random::ThreadSeed(run_seed, i),
+                .trace = trace,
+                .thread = static_cast<uint32_t>(i),
+                .trace_start = start,
+                .race = &race,
+                .warm_start = warm_first && i == 0
+            };
+            if (incumbent_callback) {
+                ctx.on_incumbent = [this](const Solution& incumbent) {
+                    // общее лучшее обновляется без блокировки, поэтому более слабое решение
+                    // может прийти сюда позже сильного
+                    std::lock_guard lock(incumbent_mutex);
+                    if (incumbent.score <= published_score) {
+                        return;
+                    }
+                    published_score = incumbent.score;
+                    incumbent_callback(incumbent, elapsed_us(start));
+                };
+            }
+            auto& state = states[i];
+            if (state.points.empty()) {
+                // подзадача на вершинах из первого шага: склад и точки в порядке обхода без конечного склада,
+                // так не нужно копировать всю задачу и отображать вершины при каждой оценке пути
+                state.points.assign(answers[i].vertexes.begin(), answers[i].vertexes.end() - 1);
+                state.sub_input = instance().restrict_to(state.points);
+            }
+            ctx.population = &state.population;
+            ctx.checkpoint = checkpoints ? &*checkpoints : nullptr;
+            {
+                TimelineSpan span("solver", "Optimize", static_cast<int64_t>(i));
+                solutions[i] = Optimize(answers[i], state.points, state.sub_input, ctx);
+            }
+            race.finish(i);
+            traces[i] = std::move(ctx.time_iterations);
+
+            auto& local = LocalStatistics();
+            local.path_evaluations = InputData::path_evaluations - path_evaluations;
+            local.cost_evaluations = InputData::cost_evaluations - cost_evaluations;
+            search_statistics[i] = local;
+
+            auto& thread_statistics = statistics.threads[slot];
+            const auto outcome = race.outcome(i);
+            thread_statistics.answer = i;
+            thread_statistics.rungs = outcome.rungs;
+            thread_statistics.eliminated = outcome.eliminated;
+            thread_statistics.hopeless = outcome.hopeless;
+            thread_statistics.score = solutions[i]->score;
+            thread_statistics.elapsed_us = elapsed_us(thread_start);
+            thread_statistics.path_evaluations = local.path_evaluations;
+            thread_statistics.evaluations_per_second =
+                    local.path_evaluations * 1e6 / std::max<uint64_t>(thread_statistics.elapsed_us, 1);
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (checkpoints) {
+        checkpoints->stop();
+        statistics.checkpoints_written = checkpoints->written();
+    }
+
+    statistics.search = SearchStatistics{};
+    for (const auto& local: search_statistics) {
+        statistics.search.merge(local);
+    }
+
+    // после обновления срезов поток может не найти допустимого решения на своих вершинах,
+    // поэтому допустимые решения сравниваются выше любых недопустимых
+    auto rank = [this](const Solution& solution) {
+        const bool feasible = solution.time <= instance().max_time && solution.distance <= instance().max_distance;
+        return std::make_pair(feasible, solution.score);
+    };
+    std::optional<size_t> best_index;
+    for (size_t i = 0; i < solutions.size(); ++i) {
+        if (solutions[i].has_value()) {
+            if (!best_index.has_value() || rank(*solutions[i]) > rank(*solutions[*best_index])) {
+                best_index = i;
+            }
+        }
+    }
+
+    statistics.second_step_us = elapsed_us(second_step_start);
+    result.statistics = statistics;
+
+    for (auto& thread_trace: traces) {
+        result.trace.insert(result.trace.end(), thread_trace.begin(), thread_trace.end());
+    }
+    std::stable_sort(result.trace.begin(), result.trace.end(),
+                     [](const auto& lhs, const auto& rhs) { return lhs.timestamp_us < rhs.timestamp_us; });
+
+    if (best_index.has_value()) {
+        result.solution = std::move(*solutions[*best_index]);
+    }
+
+    return result;
+}
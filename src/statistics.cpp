@@ -0,0 +1,70 @@
+#include "../include/statistics.hpp"
+
+void SearchStatistics::merge(const SearchStatistics &other) {
+    population_init_us += other.population_init_us;
+    initial_vns_us += other.initial_vns_us;
+    ga_loop_us += other.ga_loop_us;
+
+    path_evaluations += other.path_evaluations;
+    cost_evaluations += other.cost_evaluations;
+
+    for (size_t i = 0; i < vnd_applied.size(); ++i) {
+        vnd_applied[i] += other.vnd_applied[i];
+        vnd_accepted[i] += other.vnd_accepted[i];
+        perturbation_applied[i] += other.perturbation_applied[i];
+        perturbation_accepted[i] += other.perturbation_accepted[i];
+        neighbourhood_gain[i] += other.neighbourhood_gain[i];
+        neighbourhood_cpu_us[i] += other.neighbourhood_cpu_us[i];
+    }
+    for (size_t i = 0; i < crossover_applied.size(); ++i) {
+        crossover_applied[i] += other.crossover_applied[i];
+        crossover_accepted[i] += other.crossover_accepted[i];
+        crossover_cpu_us[i] += other.crossover_cpu_us[i];
+    }
+
+    cache_lookups += other.cache_lookups;
+    cache_hits += other.cache_hits;
+    perturbation_skips += other.perturbation_skips;
+    move_bound_checks += other.move_bound_checks;
+    move_bound_score_skips += other.move_bound_score_skips;
+    move_bound_distance_skips += other.move_bound_distance_skips;
+    limited_evaluations += other.limited_evaluations;
+    early_aborts += other.early_aborts;
+    resumed_solutions += other.resumed_solutions;
+    resume_dropped += other.resume_dropped;
+
+    ga_iterations += other.ga_iterations;
+    dedup_rejections += other.dedup_rejections;
+}
+
+std::string SolverStatistics::csv_header() {
+    std::string header = "first_step_us,second_step_us,population_init_us,initial_vns_us,ga_loop_us,"
+                         "path_evaluations,evaluations_per_second,ga_iterations,dedup_rejections";
+    for (auto name: SearchStatistics::neighbourhood_names) {
+        header += std::string(",vnd_accepted_") + name;
+    }
+    for (auto name: SearchStatistics::crossover_names) {
+        header += std::string(",crossover_accepted_") + name + ",crossover_applied_" + name;
+    }
+    return header;
+}
+
+std::string SolverStatistics::get_data_to_csv() const {
+    double evaluations_per_second = 0;
+    for (const auto &thread: threads) {
+        evaluations_per_second += thread.evaluations_per_second;
+    }
+
+    std::string data = std::to_string(first_step_us) + "," + std::to_string(second_step_us) + "," +
+                       std::to_string(search.population_init_us) + "," + std::to_string(search.initial_vns_us) + "," +
+                       std::to_string(search.ga_loop_us) + "," + std::to_string(search.path_evaluations) + "," +
+                       std::to_string(static_cast<uint64_t>(evaluations_per_second)) + "," +
+                       std::to_string(search.ga_iterations) + "," + std::to_string(search.dedup_rejections);
+    for (auto accepted: search.vnd_accepted) {
+        data += "," + std::to_string(accepted);
+    }
+    for (size_t i = 0; i < search.crossover_applied.size(); ++i) {
+        data += "," + std::to_string(search.crossover_accepted[i]) + "," + std::to_string(search.crossover_applied[i]);
+    }
+    return data;
+}
@@ -0,0 +1,163 @@
+#include "../include/timeline.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+    struct Event {
+        const char *category;
+        const char *name;
+        int64_t value;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+    };
+
+    /// Буфер пишет только поток-владелец, читатель видит первые @size событий
+    struct ThreadBuffer {
+        ThreadBuffer(size_t capacity, uint32_t tid) : events(capacity), tid(tid) {}
+
+        std::vector<Event> events;
+        std::atomic<size_t> size{0};
+        std::atomic<uint64_t> dropped{0};
+        uint32_t tid;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        /// буферы завершившихся потоков, новые потоки дописывают в них, чтобы память не росла
+        std::vector<ThreadBuffer *> free_buffers;
+        size_t capacity = 0;
+        std::chrono::steady_clock::time_point origin;
+    };
+
+    Registry &GetRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    /// Буфер захватывается потоком при первой записи и возвращается в реестр при его завершении
+    class BufferLease {
+    public:
+        ThreadBuffer &get() {
+            if (buffer == nullptr) [[unlikely]] {
+                auto &registry = GetRegistry();
+                std::lock_guard lock(registry.mutex);
+                if (!registry.free_buffers.empty()) {
+                    buffer = registry.free_buffers.back();
+                    registry.free_buffers.pop_back();
+                } else {
+                    auto tid = static_cast<uint32_t>(registry.buffers.size() + 1);
+                    registry.buffers.push_back(std::make_unique<ThreadBuffer>(registry.capacity, tid));
+                    buffer = registry.buffers.back().get();
+                }
+            }
+            return *buffer;
+        }
+
+        ~BufferLease() {
+            if (buffer != nullptr) {
+                auto &registry = GetRegistry();
+                std::lock_guard lock(registry.mutex);
+                registry.free_buffers.push_back(buffer);
+            }
+        }
+
+    private:
+        ThreadBuffer *buffer = nullptr;
+    };
+
+    uint64_t NanosecondsSince(std::chrono::steady_clock::time_point origin, std::chrono::steady_clock::time_point at) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(at - origin).count();
+    }
+}
+
+namespace Timeline {
+    void Enable(size_t events_per_thread) {
+        auto &registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+        if (enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        registry.capacity = std::max<size_t>(events_per_thread, 1);
+        registry.origin = std::chrono::steady_clock::now();
+        enabled.store(true, std::memory_order_release);
+    }
+
+    void Record(const char *category, const char *name, int64_t value,
+                std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+        static thread_local BufferLease lease;
+        auto &buffer = lease.get();
+
+        auto idx = buffer.size.load(std::memory_order_relaxed);
+        if (idx >= buffer.events.size()) [[unlikely]] {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // origin не меняется после включения записи, а запись включена до создания интервала
+        const auto origin = GetRegistry().origin;
+        buffer.events[idx] = Event{
+                .category = category,
+                .name = name,
+                .value = value,
+                .start_ns = start > origin ? NanosecondsSince(origin, start) : 0,
+                .duration_ns = end > start ? NanosecondsSince(start, end) : 0
+        };
+        buffer.size.store(idx + 1, std::memory_order_release);
+    }
+
+    bool WriteChromeTrace(const std::string &path) {
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Can`t open output file to write timeline" << std::endl;
+            return false;
+        }
+
+        auto &registry = GetRegistry();
+        std::lock_guard lock(registry.mutex);
+
+        // ts и dur в формате Chrome trace - микросекунды, дробная часть сохраняет наносекунды
+        auto write_us = [&file](uint64_t ns) {
+            file << ns / 1000 << '.' << static_cast<char>('0' + ns / 100 % 10)
+                 << static_cast<char>('0' + ns / 10 % 10) << static_cast<char>('0' + ns % 10);
+        };
+
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        for (const auto &buffer: registry.buffers) {
+            if (!first) {
+                file << ",\n";
+            }
+            first = false;
+            file << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->tid
+                 << R"(,"args":{"name":"solver thread )" << buffer->tid << "\"}}";
+
+            auto size = buffer->size.load(std::memory_order_acquire);
+            for (size_t i = 0; i < size; ++i) {
+                const auto &event = buffer->events[i];
+                file << ",\n" << R"({"name":")" << event.name << R"(","cat":")" << event.category
+                     << R"(","ph":"X","pid":1,"tid":)" << buffer->tid << ",\"ts\":";
+                write_us(event.start_ns);
+                file << ",\"dur\":";
+                write_us(event.duration_ns);
+                if (event.value >= 0) {
+                    file << R"(,"args":{"value":)" << event.value << '}';
+                }
+                file << '}';
+            }
+
+            auto dropped = buffer->dropped.load(std::memory_order_relaxed);
+            if (dropped > 0) {
+                std::cerr << "Timeline buffer of thread " << buffer->tid << " overflowed, dropped "
+                          << dropped << " spans" << std::endl;
+            }
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+}
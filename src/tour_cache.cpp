@@ -0,0 +1,60 @@
+#include "../include/tour_cache.hpp"
+
+void TourCache::reset(size_t capacity) {
+    entries.clear();
+    hands.clear();
+    set_mask = 0;
+    if (capacity == 0) {
+        return;
+    }
+
+    // число наборов - степень двойки, чтобы набор выбирался маской младших битов хэша
+    size_t sets = 1;
+    while (sets * ways < capacity) {
+        sets *= 2;
+    }
+    entries.assign(sets * ways, Entry{});
+    hands.assign(sets, 0);
+    set_mask = sets - 1;
+}
+
+const TourCache::Entry *TourCache::find(uint64_t hash) {
+    auto *set = &entries[(hash & set_mask) * ways];
+    for (size_t way = 0; way < ways; ++way) {
+        if (set[way].used && set[way].hash == hash) {
+            set[way].referenced = true;
+            return &set[way];
+        }
+    }
+    return nullptr;
+}
+
+void TourCache::insert(uint64_t hash, int64_t distance, int64_t time, int64_t score, bool local_optimum) {
+    const auto set_index = hash & set_mask;
+    auto *set = &entries[set_index * ways];
+
+    Entry *victim = nullptr;
+    for (size_t way = 0; way < ways; ++way) {
+        if (set[way].used && set[way].hash == hash) {
+            set[way].referenced = true;
+            set[way].local_optimum = set[way].local_optimum || local_optimum;
+            return;
+        }
+        if (!set[way].used && victim == nullptr) {
+            victim = &set[way];
+        }
+    }
+
+    if (victim == nullptr) {
+        // CLOCK: снимаем бит обращения, пока не найдем запись без него
+        auto &hand = hands[set_index];
+        while (set[hand].referenced) {
+            set[hand].referenced = false;
+            hand = static_cast<uint8_t>((hand + 1) % ways);
+        }
+        victim = &set[hand];
+        hand = static_cast<uint8_t>((hand + 1) % ways);
+    }
+
+    *victim = Entry{hash, distance, time, score, true, false, local_optimum};
+}
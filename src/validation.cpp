@@ -0,0 +1,108 @@
+#include "../include/validation.hpp"
+
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+namespace {
+    // время перехода с линейной интерполяцией между соседними срезами time_matrix,
+    // для времени после последнего среза берется последний срез
+    int64_t TravelTime(const InputData &input, int64_t departure, Vertex from, Vertex to) {
+        const auto &slices = input.time_matrix;
+        const auto last = static_cast<int64_t>(slices.size()) - 1;
+        if (departure >= InputData::time_duration * last) {
+            return slices[last][from][to];
+        }
+
+        // точная рациональная интерполяция, дробная часть отбрасывается
+        const auto slice = departure / InputData::time_duration;
+        const auto weight = departure - InputData::time_duration * slice;
+        const auto numerator = slices[slice][from][to] * (InputData::time_duration - weight) +
+                               slices[slice + 1][from][to] * weight;
+        return numerator / InputData::time_duration;
+    }
+}
+
+namespace Validation {
+    Metrics Evaluate(const InputData &input, const Path &tour) {
+        Metrics metrics;
+        if (tour.size() <= 2) {
+            return metrics;
+        }
+
+        for (size_t i = 0; i + 1 < tour.size(); ++i) {
+            const auto from = tour[i];
+            const auto to = tour[i + 1];
+            const auto travel = TravelTime(input, metrics.time, from, to);
+
+            metrics.distance += input.distance_matrix[from][to];
+            metrics.time += travel;
+            metrics.score -= travel;
+            if (to != 0) {
+                metrics.time += input.point_service_times[to - 1];
+                metrics.score += input.point_scores[to - 1];
+            }
+        }
+        return metrics;
+    }
+
+    std::string CheckTour(const InputData &input, const Path &tour) {
+        if (tour.size() < 2) {
+            return "tour is shorter than depot -> depot";
+        }
+        if (tour.front() != 0 || tour.back() != 0) {
+            return "depot not at start/end";
+        }
+
+        std::vector<bool> seen(input.points_count, false);
+        for (size_t i = 1; i + 1 < tour.size(); ++i) {
+            const auto vertex = tour[i];
+            if (vertex >= input.points_count) {
+                return "vertex " + std::to_string(vertex) + " out of range at position " + std::to_string(i);
+            }
+            if (vertex == 0) {
+                return "depot inside tour at position " + std::to_string(i);
+            }
+            if (seen[vertex]) {
+                return "duplicate vertex " + std::to_string(vertex) + " at position " + std::to_string(i);
+            }
+            seen[vertex] = true;
+        }
+        return {};
+    }
+
+    std::string CheckSameVertices(const Path &tour, const Path &reference) {
+        if (tour.size() != reference.size()) {
+            return "tour size " + std::to_string(tour.size()) + " differs from " + std::to_string(reference.size());
+        }
+
+        auto sorted_tour = tour;
+        auto sorted_reference = reference;
+        std::sort(sorted_tour.begin(), sorted_tour.end());
+        std::sort(sorted_reference.begin(), sorted_reference.end());
+        if (sorted_tour != sorted_reference) {
+            return "missing or extra vertices";
+        }
+        return {};
+    }
+
+    std::string CheckConstraints(const InputData &input, const Path &tour, const Metrics &metrics) {
+        const auto load = tour.size() >= 2 ? tour.size() - 2 : 0;
+        if (load < input.min_load || load > input.max_load) {
+            return "load " + std::to_string(load) + " outside [" + std::to_string(input.min_load) + ", " +
+                   std::to_string(input.max_load) + "]";
+        }
+        if (metrics.time > input.max_time) {
+            return "time " + std::to_string(metrics.time) + " exceeds max_time " + std::to_string(input.max_time);
+        }
+        if (metrics.distance > input.max_distance) {
+            return "distance " + std::to_string(metrics.distance) + " exceeds max_distance " +
+                   std::to_string(input.max_distance);
+        }
+        return {};
+    }
+}
+
+std::ostream &operator<<(std::ostream &os, const Validation::Metrics &metrics) {
+    return os << "distance " << metrics.distance << ", time " << metrics.time << ", score " << metrics.score;
+}
@@ -1,10 +1,19 @@
 #include "../include/vnd.hpp"
+#include "../include/statistics.hpp"
+#include "../include/timeline.hpp"
+#include "../include/tour_cache.hpp"
+#include "../include/batch_evaluator.hpp"
+#include "../include/cancellation.hpp"
+#include "../utils/random.hpp"
 
 #include <cassert>
 #include <utility>
 #include <random>
 #include <vector>
 #include <initializer_list>
+#include <limits>
+#include <optional>
+#include <tuple>
 
 #ifdef DEBUG
 #include "../utils/debug.h"
@@ -12,7 +21,327 @@
 
 namespace {
     // Генератор для DoubleBridge
-    thread_local std::mt19937 rng_gen(std::random_device{}());
+    thread_local Random::Generator rng_gen(Random::NondeterministicSeed());
+
+    /// Оценки уровней окрестностей для адаптивного режима, индекс - уровень
+    struct AdaptiveNeighbourhoods {
+        /// вес нового замера в скользящем среднем
+        static constexpr double score_decay = 0.2;
+        /// доля вероятности выбора в Perturbation, которая делится поровну между уровнями
+        static constexpr double exploration = 0.2;
+
+        bool enabled = false;
+        std::vector<double> gain_per_ms;
+        std::vector<uint64_t> passes;
+        /// порядок обхода уровней в VND
+        std::vector<int> order;
+
+        void reset(bool enable) {
+            enabled = enable;
+            gain_per_ms.clear();
+            passes.clear();
+        }
+
+        void update(int level, int64_t gain, uint64_t cpu_us) {
+            if (passes.size() <= static_cast<size_t>(level)) {
+                passes.resize(level + 1, 0);
+                gain_per_ms.resize(level + 1, 0);
+            }
+            const double rate = static_cast<double>(gain) * 1000.0 / static_cast<double>(std::max<uint64_t>(cpu_us, 1));
+            ++passes[level];
+            const double weight = std::max(score_decay, 1.0 / static_cast<double>(passes[level]));
+            gain_per_ms[level] += weight * (rate - gain_per_ms[level]);
+        }
+
+        /// уровни 1..max(@maxLevel-1, 1) по убыванию оценки, еще не пройденные - первыми в исходном порядке
+        void sort_levels(int maxLevel) {
+            order.resize(std::max(maxLevel - 1, 1));
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = static_cast<int>(i) + 1;
+            }
+            auto key = [this](int level) {
+                return static_cast<size_t>(level) < passes.size() && passes[level] > 0
+                       ? gain_per_ms[level] : std::numeric_limits<double>::infinity();
+            };
+            std::stable_sort(order.begin(), order.end(), [&key](int a, int b) { return key(a) > key(b); });
+        }
+
+        /// уровень рулеткой по оценкам среди уровней, которые уже проходил VND; 0 - уровней еще нет
+        int pick() {
+            const int levels = static_cast<int>(passes.size()) - 1;
+            if (levels < 1) {
+                return 0;
+            }
+            double total = 0;
+            for (int level = 1; level <= levels; ++level) {
+                total += std::max(gain_per_ms[level], 0.0);
+            }
+            double point = std::uniform_real_distribution<double>(0.0, 1.0)(rng_gen);
+            for (int level = 1; level < levels; ++level) {
+                point -= exploration / levels +
+                         (total > 0 ? (1.0 - exploration) * std::max(gain_per_ms[level], 0.0) / total
+                                    : (1.0 - exploration) / levels);
+                if (point < 0) {
+                    return level;
+                }
+            }
+            return levels;
+        }
+    };
+
+    thread_local AdaptiveNeighbourhoods adaptive;
+
+    thread_local TourCache tour_cache;
+    /// префиксные xor ключей Zobrist текущего решения окрестности: хэш позиций [l, r) - prefix[r] ^ prefix[l]
+    thread_local std::vector<uint64_t> hash_prefix;
+
+    /// заполняет hash_prefix для @tour и возвращает его хэш
+    uint64_t PrepareHash(const Path &tour) {
+        hash_prefix.resize(tour.size() + 1);
+        hash_prefix[0] = 0;
+        for (size_t i = 0; i < tour.size(); ++i) {
+            hash_prefix[i + 1] = hash_prefix[i] ^ ZobristKey(i, tour[i]);
+        }
+        return hash_prefix[tour.size()];
+    }
+
+    /// хэш маршрута @tour, который отличается от подготовленного в PrepareHash только позициями [from, to)
+    uint64_t MovedHash(const Path &tour, size_t from, size_t to) {
+        return hash_prefix.back() ^ hash_prefix[to] ^ hash_prefix[from] ^ TourHashRange(tour, from, to);
+    }
+
+    /// хэш подготовленного маршрута после обмена вершин @a на позиции @i и @b на позиции @j
+    uint64_t SwappedHash(size_t i, Vertex a, size_t j, Vertex b) {
+        return hash_prefix.back() ^ ZobristKey(i, a) ^ ZobristKey(i, b) ^ ZobristKey(j, b) ^ ZobristKey(j, a);
+    }
+
+    /// Отрезок старого маршрута в новом: позиции [from, to], при reversed проходится от to к from
+    struct Piece {
+        size_t from;
+        size_t to;
+        bool reversed = false;
+    };
+
+    /// Оптимистичная оценка хода окрестности без полной оценки маршрута. Ходы переставляют те же
+    /// вершины, поэтому score = сумма важностей - суммарное время переходов. Интерполированное время
+    /// перехода не меньше минимума по срезам, поэтому время переходов нового маршрута не меньше точного
+    /// времени неизменного начала плюс суммы минимумов по остальным ребрам; эта сумма и расстояние
+    /// считаются за O(число отрезков) по префиксным суммам базового маршрута.
+    /// Ограничение max_time при выборе хода не проверяется, поэтому отсев по нему не делается.
+    class MoveBounds {
+    public:
+        /// минимумы времени перехода по срезам для @input, nullptr выключает отсев
+        void reset(const InputData *input) {
+            target = input;
+            min_travel.clear();
+            if (input == nullptr) {
+                return;
+            }
+            points = input->points_count;
+            min_travel.assign(input->time_matrix[0].size() * points, 0);
+            for (size_t from = 0; from < points; ++from) {
+                std::copy(input->time_matrix[0][from].begin(), input->time_matrix[0][from].end(),
+                          min_travel.begin() + static_cast<ptrdiff_t>(from * points));
+            }
+            for (size_t slice = 1; slice < input->time_matrix.size(); ++slice) {
+                for (size_t from = 0; from < points; ++from) {
+                    const auto &row = input->time_matrix[slice][from];
+                    auto *minimum = &min_travel[from * points];
+                    for (size_t to = 0; to < points; ++to) {
+                        minimum[to] = std::min(minimum[to], row[to]);
+                    }
+                }
+            }
+        }
+
+        /// Границы оценки с досрочным выходом для @inputData: с минимумами по срезам,
+        /// если отсев включен для этой задачи
+        EvaluationLimits limits(const InputData &inputData, int64_t best_score) const {
+            EvaluationLimits result{.max_distance = inputData.max_distance, .min_score = best_score};
+            if (target == &inputData) {
+                result.min_travel = min_travel.data();
+            }
+            return result;
+        }
+
+        /// Готовит префиксные суммы для ходов от @solution, false - отсев для @inputData выключен
+        bool prepare(const Solution &solution, const InputData &inputData) {
+            if (target != &inputData) {
+                return false;
+            }
+            input = &inputData;
+            tour = &solution.tour;
+            const auto &path = solution.tour;
+            const auto size = path.size();
+            travel.assign(size, 0);
+            forward.assign(size, 0);
+            backward.assign(size, 0);
+            distance_forward.assign(size, 0);
+            distance_backward.assign(size, 0);
+            scores = 0;
+
+            // точное время переходов считается так же, как в get_path_time_distance_score
+            int64_t time = 0;
+            for (size_t k = 0; k + 1 < size; ++k) {
+                const auto from = path[k];
+                const auto to = path[k + 1];
+                const auto travel_time = inputData.get_time_dependent_cost(time, from, to);
+                time += (to == 0 ? 0 : inputData.point_service_times[to - 1]) + travel_time;
+                scores += to == 0 ? 0 : inputData.point_scores[to - 1];
+
+                travel[k + 1] = travel[k] + travel_time;
+                forward[k + 1] = forward[k] + min_travel[from * points + to];
+                backward[k + 1] = backward[k] + min_travel[to * points + from];
+                distance_forward[k + 1] = distance_forward[k] + inputData.distance_matrix[from][to];
+                distance_backward[k + 1] = distance_backward[k] + inputData.distance_matrix[to][from];
+            }
+            return true;
+        }
+
+        /// Ход, дающий маршрут из отрезков @pieces базового маршрута, заведомо не дает score больше
+        /// @best_score или нарушает max_distance. Первый отрезок - неизменное начало [0, @first_changed - 1].
+        bool skip(std::initializer_list<Piece> pieces, size_t first_changed, int64_t best_score) {
+            auto &statistics = LocalStatistics();
+            ++statistics.move_bound_checks;
+
+            const auto &path = *tour;
+            int64_t distance = 0;
+            // ребра до позиции first_changed - 1 не изменились, время на них точное
+            int64_t lower_travel = travel[first_changed - 1];
+            bool started = false;
+            Vertex last = 0;
+            for (const auto &piece: pieces) {
+                if (piece.from > piece.to) {
+                    continue;
+                }
+                const auto first = piece.reversed ? piece.to : piece.from;
+                if (started) {
+                    distance += input->distance_matrix[last][path[first]];
+                    lower_travel += min_travel[last * points + path[first]];
+                }
+                if (piece.reversed) {
+                    distance += distance_backward[piece.to] - distance_backward[piece.from];
+                    lower_travel += backward[piece.to] - backward[piece.from];
+                } else {
+                    distance += distance_forward[piece.to] - distance_forward[piece.from];
+                    // ребра неизменного начала [0, first_changed - 1] уже учтены точным временем
+                    if (piece.from > 0) {
+                        lower_travel += forward[piece.to] - forward[piece.from];
+                    }
+                }
+                last = path[piece.reversed ? piece.from : piece.to];
+                started = true;
+            }
+
+            if (distance > input->max_distance) {
+                ++statistics.move_bound_distance_skips;
+                return true;
+            }
+            if (scores - lower_travel <= best_score) {
+                ++statistics.move_bound_score_skips;
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        const InputData *target = nullptr;
+        const InputData *input = nullptr;
+        const Path *tour = nullptr;
+        size_t points = 0;
+        /// минимум времени перехода по срезам, min_travel[from * points + to]
+        std::vector<int64_t> min_travel;
+        /// префиксные суммы по ребрам k -> k + 1 базового маршрута: точное время перехода,
+        /// минимумы по срезам в прямом и обратном направлении, расстояния в обоих направлениях
+        std::vector<int64_t> travel;
+        std::vector<int64_t> forward;
+        std::vector<int64_t> backward;
+        std::vector<int64_t> distance_forward;
+        std::vector<int64_t> distance_backward;
+        /// сумма важностей вершин маршрута, одинакова для всех ходов
+        int64_t scores = 0;
+    };
+
+    thread_local MoveBounds move_bounds;
+
+    /// Оценка @tour с досрочным выходом, если маршрут заведомо не дает score больше @best_score
+    /// или нарушает max_distance, тогда nullopt
+    std::optional<std::tuple<int64_t, int64_t, int64_t>> EvaluateImproving(const Path &tour, int64_t best_score,
+                                                                           const InputData &inputData) {
+        auto &statistics = LocalStatistics();
+        ++statistics.limited_evaluations;
+        auto result = inputData.get_path_time_distance_score(tour, move_bounds.limits(inputData, best_score));
+        if (!result) {
+            ++statistics.early_aborts;
+        }
+        return result;
+    }
+
+    /// Оценка соседа @tour, который принимается только со score больше @best_score и в пределах max_distance.
+    /// При включенном кэше (@cached, @hash - хэш соседа) берется из кэша потока, иначе считается с досрочным
+    /// выходом. nullopt - сосед заведомо не принимается, такие в кэш не пишутся.
+    std::optional<std::tuple<int64_t, int64_t, int64_t>> EvaluateMove(const Path &tour, bool cached, uint64_t hash,
+                                                                      int64_t best_score, const InputData &inputData) {
+        if (cached) {
+            auto &statistics = LocalStatistics();
+            ++statistics.cache_lookups;
+            if (const auto *entry = tour_cache.find(hash)) {
+                ++statistics.cache_hits;
+                return std::make_tuple(entry->distance, entry->time, entry->score);
+            }
+        }
+        auto result = EvaluateImproving(tour, best_score, inputData);
+        if (result && cached) {
+            const auto [distance, time, score] = *result;
+            tour_cache.insert(hash, distance, time, score);
+        }
+        return result;
+    }
+
+    /// пакетная оценка возмущений текущего потока, nullptr - по одному
+    thread_local BatchEvaluator *batch_evaluator = nullptr;
+    /// мостов, оцениваемых за раз при пакетной оценке: в среднем столько возмущений делается до принятия
+    constexpr int perturbation_batch = 4;
+    thread_local std::vector<Solution *> pending_bridges;
+
+    /// Оценка возмущенных маршрутов @bridges: из кэша, если он включен, остальные - пачкой
+    /// в batch_evaluator или по одному
+    void EvaluateBridges(std::vector<Solution> &bridges, const InputData &inputData) {
+        auto &statistics = LocalStatistics();
+        pending_bridges.clear();
+        for (auto &bridge: bridges) {
+            if (tour_cache.enabled()) {
+                ++statistics.cache_lookups;
+                if (const auto *entry = tour_cache.find(TourHash(bridge.tour))) {
+                    ++statistics.cache_hits;
+                    bridge.distance = entry->distance, bridge.time = entry->time, bridge.score = entry->score;
+                    continue;
+                }
+            }
+            pending_bridges.push_back(&bridge);
+        }
+
+        if (batch_evaluator != nullptr) {
+            batch_evaluator->evaluate(pending_bridges.data(), pending_bridges.size());
+        } else {
+            for (auto *bridge: pending_bridges) {
+                auto [distance, time, score] = inputData.get_path_time_distance_score(bridge->tour);
+                bridge->distance = distance, bridge->time = time, bridge->score = score;
+            }
+        }
+
+        if (tour_cache.enabled()) {
+            for (const auto *bridge: pending_bridges) {
+                tour_cache.insert(TourHash(bridge->tour), bridge->distance, bridge->time, bridge->score);
+            }
+        }
+    }
+
+    /// номер окрестности в счетчиках SearchStatistics, уровни больше OrOpt (и 0) считаются как OrOpt
+    size_t NeighbourhoodIndex(int level) {
+        const auto count = static_cast<int>(SearchStatistics::neighbourhood_names.size());
+        return static_cast<size_t>((level < 1 || level > count ? count : level) - 1);
+    }
 
     // Время работы O(n) из-за проблем со вставкой в вектор
     // TODO() подумать над оптимизацией
@@ -42,14 +371,33 @@ namespace {
     Solution Shift(const Solution &solution, const InputData &inputData) {
         auto path_size = solution.tour.size();
         auto best = solution;
+        const bool cached = tour_cache.enabled();
+        if (cached) {
+            PrepareHash(solution.tour);
+        }
+
+        const bool bounded = move_bounds.prepare(solution, inputData);
+        const size_t last = path_size - 1;
 
         // не учитываем начальную и конечную вершину - депо
         for (auto i = 1; i < path_size - 1; ++i) {
             for (auto j = 1; j < path_size - 1; ++j) {
                 if (i != j) {
+                    const auto from = static_cast<size_t>(i), to = static_cast<size_t>(j);
+                    if (bounded && (from < to
+                            ? move_bounds.skip({{0, from - 1}, {from + 1, to - 1}, {from, from}, {to, last}}, from, best.score)
+                            : move_bounds.skip({{0, to - 1}, {from, from}, {to, from - 1}, {from + 1, last}}, to, best.score))) {
+                        continue;
+                    }
                     auto temp = shift_move(solution, i, j);
-                    auto [distance, time, score] = inputData.get_path_time_distance_score(temp.tour);
-                    temp.time = time, temp.distance = distance, temp.score = score;
+                    // сдвиг меняет только позиции между i и j
+                    const auto evaluation = EvaluateMove(
+                            temp.tour, cached, cached ? MovedHash(temp.tour, std::min(i, j), std::max(i, j) + 1) : 0,
+                            best.score, inputData);
+                    if (!evaluation) {
+                        continue;
+                    }
+                    std::tie(temp.distance, temp.time, temp.score) = *evaluation;
 
                     if (best.score < temp.score && temp.distance <= inputData.max_distance) {
                         best = std::move(temp);
@@ -69,12 +417,26 @@ namespace {
         // лучшая позиция для swap, если такой нет, то останется нулем
         size_t best_i = 0;
         auto best_score = best.score;
+        const bool cached = tour_cache.enabled();
+        if (cached) {
+            PrepareHash(solution.tour);
+        }
+        const bool bounded = move_bounds.prepare(solution, inputData);
         // меняем только внутренние вершины без первой и последней тк это депо
         for (size_t i = 1; i < path_size - 2; ++i) {
+            if (bounded && move_bounds.skip({{0, i - 1}, {i + 1, i + 1}, {i, i}, {i + 2, path_size - 1}}, i, best_score)) {
+                continue;
+            }
             best.tour[i] = std::exchange(best.tour[i + 1], best.tour[i]);
-            auto [distance, time, score] = inputData.get_path_time_distance_score(best.tour);
+            const auto evaluation = EvaluateMove(
+                    best.tour, cached, cached ? SwappedHash(i, best.tour[i + 1], i + 1, best.tour[i]) : 0,
+                    best_score, inputData);
             // возврат пути в прежнее состояние
             best.tour[i] = std::exchange(best.tour[i + 1], best.tour[i]);
+            if (!evaluation) {
+                continue;
+            }
+            const auto [distance, time, score] = *evaluation;
             if (best_score < score && distance <= inputData.max_distance) {
                 // в случае если не было улучшений возвращаем все как было
                 best_i = i, best_score = score;
@@ -98,15 +460,30 @@ namespace {
         // аналогично как в SwapAdjacent
         size_t best_i = 0, best_j = 0;
         auto best_score = best.score;
+        const bool cached = tour_cache.enabled();
+        if (cached) {
+            PrepareHash(solution.tour);
+        }
+        const bool bounded = move_bounds.prepare(solution, inputData);
         // меняем только внутренние вершины без первой и последней тк это депо
         for (size_t i = 1; i < path_size - 1; ++i) {
             // чтобы менять только пары вида (i, j): i < j
             for (size_t j = i + 1; j < path_size - 1; ++j) {
+                if (bounded && move_bounds.skip({{0, i - 1}, {j, j}, {i + 1, j - 1}, {i, i}, {j + 1, path_size - 1}},
+                                                i, best_score)) {
+                    continue;
+                }
 
                 best.tour[i] = std::exchange(best.tour[j], best.tour[i]);
-                auto [distance, time, score] = inputData.get_path_time_distance_score(best.tour);
+                const auto evaluation = EvaluateMove(
+                        best.tour, cached, cached ? SwappedHash(i, best.tour[j], j, best.tour[i]) : 0,
+                        best_score, inputData);
                 // возврат к прежнему состоянию пути
                 best.tour[i] = std::exchange(best.tour[j], best.tour[i]);
+                if (!evaluation) {
+                    continue;
+                }
+                const auto [distance, time, score] = *evaluation;
                 if (best_score < score && distance <= inputData.max_distance) {
                     best_i = i, best_j = j, best_score = score;
                 }
@@ -130,13 +507,26 @@ namespace {
         auto best_score = best.score;
 
         size_t best_i = 0, best_j = 0;
+        const bool cached = tour_cache.enabled();
+        if (cached) {
+            PrepareHash(solution.tour);
+        }
+        const bool bounded = move_bounds.prepare(solution, inputData);
         for (size_t i = 1; i < path_size - 1; ++i) {
             for (size_t j = i + 1; j < path_size - 1; ++j) {
+                if (bounded && move_bounds.skip({{0, i - 1}, {i, j, true}, {j + 1, path_size - 1}}, i, best_score)) {
+                    continue;
+                }
 
                 std::reverse(best.tour.begin() + i, best.tour.begin() + j + 1);
-                auto [distance, time, score] = inputData.get_path_time_distance_score(best.tour);
+                const auto evaluation = EvaluateMove(best.tour, cached, cached ? MovedHash(best.tour, i, j + 1) : 0,
+                                                     best_score, inputData);
                 // возврат пути к исходному состоянию
                 std::reverse(best.tour.begin() + i, best.tour.begin() + j + 1);
+                if (!evaluation) {
+                    continue;
+                }
+                const auto [distance, time, score] = *evaluation;
 
                 if (best_score < score && distance <= inputData.max_distance) {
                     best_i = i, best_j = j, best_score = score;
@@ -163,6 +553,13 @@ namespace {
         }
 
         opt_size = std::min(opt_size, path_size - 2);
+        const bool cached = tour_cache.enabled();
+        if (cached) {
+            PrepareHash(solution.tour);
+        }
+
+        const bool bounded = move_bounds.prepare(solution, inputData);
+        const size_t last = path_size - 1;
 
         using vertexType = decltype(solution.tour)::value_type;
 
@@ -173,10 +570,25 @@ namespace {
             temp.tour.erase(temp.tour.begin() + i, temp.tour.begin() + i + opt_size);
             
             for (size_t j = 1; j < temp.tour.size(); ++j) {
+                // сегмент [i, i + opt_size) встает перед вершиной, которая в маршруте без него на позиции j
+                const auto segment_end = i + opt_size - 1;
+                if (bounded && (j <= i
+                        ? move_bounds.skip({{0, j - 1}, {i, segment_end}, {j, i - 1}, {i + opt_size, last}}, j, best_score)
+                        : move_bounds.skip({{0, i - 1}, {i + opt_size, j + opt_size - 1}, {i, segment_end},
+                                            {j + opt_size, last}}, i, best_score))) {
+                    continue;
+                }
                 temp.tour.insert(temp.tour.begin() + j, swap_elements.begin(), swap_elements.end());
-                auto [distance, time, score] = inputData.get_path_time_distance_score(temp.tour);
+                // сегмент с позиции i переехал на позицию j, остальные позиции вне [min, max + opt_size) не сдвинулись
+                const auto evaluation = EvaluateMove(
+                        temp.tour, cached, cached ? MovedHash(temp.tour, std::min(i, j), std::max(i, j) + opt_size) : 0,
+                        best_score, inputData);
                 // возврат к старому положению
                 temp.tour.erase(temp.tour.begin() + j, temp.tour.begin() + j + opt_size);
+                if (!evaluation) {
+                    continue;
+                }
+                const auto [distance, time, score] = *evaluation;
                 if (best_score < score && distance <= inputData.max_distance) {
                     best_i = i, best_j = j, best_score = score;
                 };
@@ -240,101 +652,168 @@ namespace {
     }
 }
 
+Solution ApplyNeighbourhood(int level, const Solution &solution, const InputData &inputData) {
+    OptimizationType levelType = OptimizationType(level);
+    switch (levelType) {
+        case OptimizationType::Shift: {
+            return Shift(solution, inputData);
+        }
+        case OptimizationType::SwapAdjacent: {
+            return SwapAdjacent(solution, inputData);
+        }
+        case OptimizationType::SwapAny: {
+            return SwapAny(solution, inputData);
+        }
+        case OptimizationType::TwoOpt: {
+            return TwoOpt(solution, inputData);
+        }
+        default:
+        case OptimizationType::OrOpt: {
+            size_t opt_size = 3 + (level > 5 ? level - 5 : 0);
+            return OrOpt(solution, inputData, opt_size);
+        }
+    }
+}
+
+void SeedNeighbourhoods(uint64_t seed) {
+    rng_gen = Random::Generator(seed);
+}
+
+void SetAdaptiveNeighbourhoods(bool enabled) {
+    adaptive.reset(enabled);
+}
+
+void SetTourCache(size_t capacity) {
+    tour_cache.reset(capacity);
+}
+
+void SetBatchEvaluator(BatchEvaluator *evaluator) {
+    batch_evaluator = evaluator;
+}
+
+void SetMoveBounds(const InputData *input) {
+    move_bounds.reset(input);
+}
+
 Solution VND(Solution solution, int maxLevel, const InputData &inputData) {
+    TimelineSpan span("search", "VND");
 
     auto best = solution;
     auto current = solution;
 
-    int level = 1;
-
-    do {
-        Solution temp(0);
-        temp.tour.reserve(solution.tour.size());
+    auto& statistics = LocalStatistics();
+    // в адаптивном режиме position - позиция в adaptive.order, иначе position + 1 - уровень
+    size_t position = 0;
+    if (adaptive.enabled) {
+        adaptive.sort_levels(maxLevel);
+    }
+    // как и в обычном порядке, хотя бы один уровень проходится всегда
+    const size_t levels_count = static_cast<size_t>(std::max(maxLevel - 1, 1));
 
-        OptimizationType levelType = OptimizationType(level);
-        switch (levelType) {
-            case OptimizationType::Shift: {
-                temp = Shift(current, inputData);
-                break;
-            }
-            case OptimizationType::SwapAdjacent: {
-                temp = SwapAdjacent(current, inputData);
-                break;
-            }
-            case OptimizationType::SwapAny: {
-                temp = SwapAny(current, inputData);
-                break;
-            }
-            case OptimizationType::TwoOpt: {
-                temp = TwoOpt(current, inputData);
-                break;
-            }
-            default:
-            case OptimizationType::OrOpt: {
-                size_t opt_size = 3 + (level > 5 ? level - 5 : 0);
-                temp = OrOpt(current, inputData, opt_size);
-                break;
-            }
+    while (position < levels_count) {
+        if (Cancellation::Requested()) [[unlikely]] {
+            break;
         }
-
-        auto [distance, time, score] = inputData.get_path_time_distance_score(temp.tour);
-        temp.time = time, temp.distance = distance, temp.score = score;
-
-        if (temp.score > current.score && temp.distance <= inputData.max_distance) {
+        const int level = adaptive.enabled ? adaptive.order[position] : static_cast<int>(position) + 1;
+        const auto neighbourhood = NeighbourhoodIndex(level);
+        ++statistics.vnd_applied[neighbourhood];
+        TimelineSpan pass_span("vnd", SearchStatistics::neighbourhood_names[neighbourhood], level);
+        const auto pass_start = ThreadCpuTimeUs();
+
+        auto temp = ApplyNeighbourhood(level, current, inputData);
+
+        // принимается только улучшение в пределах max_distance, остальное не досчитывается
+        const auto evaluation = EvaluateImproving(temp.tour, current.score, inputData);
+
+        int64_t gain = 0;
+        if (evaluation) {
+            std::tie(temp.distance, temp.time, temp.score) = *evaluation;
+            ++statistics.vnd_accepted[neighbourhood];
+            gain = temp.score - current.score;
             current = std::move(temp);
-            level = 1;
+            position = 0;
             if (current.score > best.score) {
                 best = current;
             }
         } else {
-            level++;
+            ++position;
         }
-    } while (level < maxLevel);
+
+        const auto pass_us = ThreadCpuTimeUs() - pass_start;
+        statistics.neighbourhood_gain[neighbourhood] += gain;
+        statistics.neighbourhood_cpu_us[neighbourhood] += pass_us;
+        if (adaptive.enabled) {
+            adaptive.update(level, gain, pass_us);
+            if (gain > 0) {
+                adaptive.sort_levels(maxLevel);
+            }
+        }
+    }
+
+    if (tour_cache.enabled()) {
+        // из результата VND ни одна окрестность не улучшает, Perturbation не будет возвращаться в него
+        tour_cache.insert(TourHash(best.tour), best.distance, best.time, best.score, true);
+    }
 
     return best;
 }
 
 Solution Perturbation(const Solution &solution, int maxLevel, double p, const InputData &inputData) {
+    TimelineSpan span("search", "Perturbation");
     Solution best = solution;
+    auto& statistics = LocalStatistics();
+
+    std::vector<Solution> bridges;
+    for (int k = 0; k <= maxLevel;) {
+        // с пакетной оценкой мосты от best строятся и оцениваются по несколько, без нее - по одному
+        const int chunk = batch_evaluator != nullptr ? std::min(perturbation_batch, maxLevel + 1 - k) : 1;
+        bridges.clear();
+        for (int i = 0; i < chunk; ++i) {
+            bridges.push_back(DoubleBridge(best));
+        }
+        EvaluateBridges(bridges, inputData);
 
-    for (int k = 0; k <= maxLevel; ++k) {
-
-        auto temp = DoubleBridge(best);
-        auto [distance, time, score] = inputData.get_path_time_distance_score(temp.tour);
-        temp.time = time, temp.distance = distance, temp.score = score;
+        for (auto &bridge: bridges) {
+            auto temp = std::move(bridge);
 
-        OptimizationType levelType = OptimizationType(k);
-        switch (levelType) {
-            case OptimizationType::Shift: {
-                temp = Shift(temp, inputData);
-                break;
-            }
-            case OptimizationType::SwapAdjacent: {
-                temp = SwapAdjacent(temp, inputData);
-                break;
-            }
-            case OptimizationType::SwapAny: {
-                temp = SwapAny(temp, inputData);
-                break;
+            // в адаптивном режиме уровень выбирается по оценкам, пока их нет - как обычно k
+            int level = k++;
+            if (adaptive.enabled) {
+                if (auto picked = adaptive.pick(); picked > 0) {
+                    level = picked;
+                }
             }
-            case OptimizationType::TwoOpt: {
-                temp = TwoOpt(temp, inputData);
-                break;
+            const auto neighbourhood = NeighbourhoodIndex(level);
+            ++statistics.perturbation_applied[neighbourhood];
+            const auto pass_start = ThreadCpuTimeUs();
+            const auto bridged_score = temp.score;
+
+            temp = ApplyNeighbourhood(level, temp, inputData);
+
+            const auto pass_us = ThreadCpuTimeUs() - pass_start;
+            const auto gain = std::max<int64_t>(temp.score - bridged_score, 0);
+            statistics.neighbourhood_gain[neighbourhood] += gain;
+            statistics.neighbourhood_cpu_us[neighbourhood] += pass_us;
+            if (adaptive.enabled) {
+                adaptive.update(level, gain, pass_us);
             }
-            default:
-            case OptimizationType::OrOpt: {
-                size_t opt_size = 3 + (k > 5 ? k - 5 : 0);
-                temp = OrOpt(temp, inputData, opt_size);
-                break;
+
+            if (tour_cache.enabled()) {
+                // уже найденный локальный оптимум: VND из него вернет его же
+                const auto *entry = tour_cache.find(TourHash(temp.tour));
+                if (entry != nullptr && entry->local_optimum) {
+                    ++statistics.perturbation_skips;
+                    continue;
+                }
             }
-        }
 
-        if (temp.time * (1.0 - p) < best.time && temp.distance <= inputData.max_distance) {
-            // допускаем небольшое ухудшение времени
-            best = std::move(temp);
-            break;
+            if (temp.time * (1.0 - p) < best.time && temp.distance <= inputData.max_distance) {
+                // допускаем небольшое ухудшение времени
+                ++statistics.perturbation_accepted[neighbourhood];
+                return temp;
+            }
         }
     }
 
     return best; // RVO
-}
\ No newline at end of file
+}
@@ -1,6 +1,9 @@
 #include "../include/vns.hpp"
+#include "../include/timeline.hpp"
+#include "../include/cancellation.hpp"
 
 Solution VNS(const Solution &solution, const InputData &inputData, int nloop, int kMax, double p) {
+    TimelineSpan span("search", "VNS");
 
     Solution best = solution;
 
@@ -8,6 +11,9 @@ Solution VNS(const Solution &solution, const InputData &inputData, int nloop, in
     auto level = 1;
 
     while (level < nloop) {
+        if (Cancellation::Requested()) [[unlikely]] {
+            break;
+        }
 
         auto temp = Perturbation(current, level, p, inputData);
         temp = VND(temp, kMax, inputData);
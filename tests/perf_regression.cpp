@@ -0,0 +1,294 @@
+#include "../bench/harness.hpp"
+#include "../include/solver.hpp"
+#include "../include/validation.hpp"
+#include "../utils/instance_generator.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+// Регрессионные проверки качества и производительности, запускаются из ctest:
+//   ./perf_regression quality <instance> <baselines.json>   - решение не хуже записанного
+//   ./perf_regression throughput <filter> <baselines.json>  - оценки в секунду ядер не ниже эталона
+//   ./perf_regression update <baselines.json>                - перезаписать эталоны на текущей машине
+//   ./perf_regression resume <checkpoint.bin>                - продолжение с чекпоинта при других срезах
+//                                                              дает допустимое решение с верными метриками
+namespace {
+    using json = nlohmann::json;
+
+    struct QualityCase {
+        GeneratorParameters params;
+        /// seed решателя, чтобы результат не зависел от запуска
+        uint64_t seed;
+        /// время второго шага в секундах
+        uint64_t time;
+    };
+
+    const std::map<std::string, QualityCase> &QualityCases() {
+        static const auto cases = []() {
+            std::map<std::string, QualityCase> result;
+
+            GeneratorParameters small;
+            small.seed = 1;
+            small.points_count = 40;
+            small.clusters = 3;
+            small.max_load_ratio = 0.4;
+            result["small"] = {small, 1, 2};
+
+            GeneratorParameters medium;
+            medium.seed = 2;
+            medium.points_count = 120;
+            medium.clusters = 4;
+            medium.max_load_ratio = 0.25;
+            result["medium"] = {medium, 1, 3};
+
+            return result;
+        }();
+        return cases;
+    }
+
+    /// группы ядер бенчмарка, по которым хранится эталон производительности
+    constexpr const char *throughput_filters[] = {
+        "eval/", "vnd/", "crossover/", "first_step/bitset=128", "first_step/bitset=256"
+    };
+
+    /// время замера ядра при проверке и при записи эталона
+    constexpr double check_min_time = 0.1;
+    constexpr double update_min_time = 0.5;
+    /// сколько раз перезамерять ядро, прежде чем признать его медленным
+    constexpr int throughput_attempts = 3;
+    /// эталон - медиана нескольких замеров, чтобы один удачный замер не завышал его
+    constexpr int update_repetitions = 3;
+
+    bool ReadBaselines(const std::string &path, json &baselines) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Can`t open baselines file " << path << std::endl;
+            return false;
+        }
+        try {
+            file >> baselines;
+        } catch (const json::exception &e) {
+            std::cerr << "Can`t parse baselines file: " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /// допуск из файла эталонов, переменная окружения @env переопределяет его
+    double Tolerance(const json &baselines, const char *name, const char *env, double fallback) {
+        if (const char *value = std::getenv(env)) {
+            return std::stod(value);
+        }
+        return baselines.value(name, fallback);
+    }
+
+    int64_t Solve(const QualityCase &quality_case) {
+        auto input = GenerateInstance(quality_case.params);
+        Solver solver(input, MetaParameters{});
+        solver.SetSeed(quality_case.seed);
+        auto result = solver.Solve(Solver::Clock::now() + std::chrono::seconds(quality_case.time));
+        return result.solution.tour.empty() ? 0 : result.solution.score;
+    }
+
+    int CheckQuality(const std::string &name, const json &baselines) {
+        auto it = QualityCases().find(name);
+        if (it == QualityCases().end()) {
+            std::cerr << "Unknown quality case " << name << std::endl;
+            return 1;
+        }
+        if (!baselines.contains("quality") || !baselines["quality"].contains(name)) {
+            std::cerr << "No quality baseline for " << name << ", run perf_regression update" << std::endl;
+            return 1;
+        }
+
+        auto baseline = baselines["quality"][name].get<int64_t>();
+        auto tolerance = Tolerance(baselines, "quality_tolerance", "PERF_QUALITY_TOLERANCE", 0.01);
+        auto score = Solve(it->second);
+        auto threshold = static_cast<int64_t>(baseline * (1.0 - tolerance));
+
+        std::cout << name << ": score " << score << ", baseline " << baseline << ", threshold " << threshold << std::endl;
+        if (score < threshold) {
+            std::cerr << "Quality regression on " << name << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    int CheckThroughput(const std::string &filter, const json &baselines) {
+        if (!baselines.contains("throughput")) {
+            std::cerr << "No throughput baselines, run perf_regression update" << std::endl;
+            return 1;
+        }
+        const auto &reference = baselines["throughput"];
+        auto tolerance = Tolerance(baselines, "throughput_tolerance", "PERF_THROUGHPUT_TOLERANCE", 0.5);
+
+        int failed = 0;
+        for (const auto &result: bench::RunAll(filter, check_min_time)) {
+            if (!reference.contains(result.name)) {
+                std::cerr << "No throughput baseline for " << result.name << ", run perf_regression update" << std::endl;
+                ++failed;
+                continue;
+            }
+
+            auto expected = reference[result.name].get<double>();
+            auto threshold = expected * (1.0 - tolerance);
+            auto measured = result.evaluations_per_second;
+            // замеры шумят, поэтому медленное ядро перезамеряется и берется лучший результат
+            for (int attempt = 1; attempt < throughput_attempts && measured < threshold; ++attempt) {
+                for (const auto &retry: bench::RunAll(result.name, check_min_time)) {
+                    if (retry.name == result.name) {
+                        measured = std::max(measured, retry.evaluations_per_second);
+                    }
+                }
+            }
+
+            std::printf("%-60s %16.0f %16.0f %7.1f%%\n", result.name.c_str(), measured, expected,
+                        100.0 * (measured / expected - 1.0));
+            if (measured < threshold) {
+                std::cerr << "Throughput regression on " << result.name << std::endl;
+                ++failed;
+            }
+        }
+        return failed == 0 ? 0 : 1;
+    }
+
+    /// срезы времени задачи, умноженные на @factor: так меняются пробки между прерванным запуском и продолжением
+    InputData ScaleSlices(const InputData &input, double factor) {
+        auto scaled = input;
+        for (auto &slice: scaled.time_matrix) {
+            for (auto &row: slice) {
+                for (auto &value: row) {
+                    value = static_cast<int64_t>(std::llround(static_cast<double>(value) * factor));
+                }
+            }
+        }
+        return scaled;
+    }
+
+    int CheckResume(const std::string &path) {
+        GeneratorParameters params;
+        params.seed = 3;
+        params.points_count = 150;
+        auto input = GenerateInstance(params);
+
+        std::filesystem::remove(path);
+        {
+            Solver solver(input, MetaParameters{});
+            solver.SetSeed(1);
+            solver.EnableCheckpoints(path, std::chrono::hours(1));
+            solver.Solve(Solver::Clock::now() + std::chrono::seconds(1));
+        }
+
+        int failed = 0;
+        // те же срезы, чуть медленнее (часть ответов первого шага остается) и сильно медленнее (ни один не
+        // укладывается в max_time, первый шаг повторяется)
+        for (double factor: {1.0, 1.05, 1.5}) {
+            const auto changed = ScaleSlices(input, factor);
+            Solver solver(changed, MetaParameters{});
+            if (!solver.Resume(path)) {
+                std::cerr << "Can`t resume with slices x" << factor << std::endl;
+                ++failed;
+                continue;
+            }
+            auto result = solver.Solve(Solver::Clock::now() + std::chrono::seconds(1));
+            const auto &solution = result.solution;
+
+            auto error = Validation::CheckTour(changed, solution.tour);
+            const auto metrics = error.empty() ? Validation::Evaluate(changed, solution.tour) : Validation::Metrics{};
+            if (error.empty() && metrics != Validation::Metrics{solution.distance, solution.time, solution.score}) {
+                error = "reported metrics differ from recomputed";
+            }
+            if (error.empty()) {
+                error = Validation::CheckConstraints(changed, solution.tour, metrics);
+            }
+
+            std::cout << "resume with slices x" << factor << ": score " << solution.score
+                      << (error.empty() ? "" : ", " + error) << std::endl;
+            if (!error.empty()) {
+                ++failed;
+            }
+        }
+        std::filesystem::remove(path);
+        return failed == 0 ? 0 : 1;
+    }
+
+    int Update(const std::string &path) {
+        json baselines = json::object();
+        {
+            // допуски, выставленные вручную, сохраняются
+            std::ifstream file(path);
+            if (file) {
+                try {
+                    file >> baselines;
+                } catch (const json::exception &) {
+                    baselines = json::object();
+                }
+            }
+        }
+        baselines.emplace("quality_tolerance", 0.01);
+        baselines.emplace("throughput_tolerance", 0.5);
+
+        baselines["quality"] = json::object();
+        for (const auto &[name, quality_case]: QualityCases()) {
+            baselines["quality"][name] = Solve(quality_case);
+            std::cout << name << ": " << baselines["quality"][name] << std::endl;
+        }
+
+        std::map<std::string, std::vector<double>> measurements;
+        for (int repetition = 0; repetition < update_repetitions; ++repetition) {
+            for (auto filter: throughput_filters) {
+                for (const auto &result: bench::RunAll(filter, update_min_time)) {
+                    measurements[result.name].push_back(result.evaluations_per_second);
+                }
+            }
+        }
+
+        baselines["throughput"] = json::object();
+        for (auto &[name, values]: measurements) {
+            std::sort(values.begin(), values.end());
+            baselines["throughput"][name] = values[values.size() / 2];
+            std::printf("%-60s %16.0f\n", name.c_str(), values[values.size() / 2]);
+        }
+
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Can`t open baselines file to write " << path << std::endl;
+            return 1;
+        }
+        file << baselines.dump(4) << "\n";
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "update" && argc == 3) {
+        return Update(argv[2]);
+    }
+
+    if (mode == "resume" && argc == 3) {
+        return CheckResume(argv[2]);
+    }
+
+    if ((mode == "quality" || mode == "throughput") && argc == 4) {
+        json baselines;
+        if (!ReadBaselines(argv[3], baselines)) {
+            return 1;
+        }
+        return mode == "quality" ? CheckQuality(argv[2], baselines) : CheckThroughput(argv[2], baselines);
+    }
+
+    std::cerr << "Usage: perf_regression quality <instance> <baselines.json>\n"
+                 "       perf_regression throughput <filter> <baselines.json>\n"
+                 "       perf_regression update <baselines.json>\n"
+                 "       perf_regression resume <checkpoint.bin>" << std::endl;
+    return 2;
+}
@@ -0,0 +1,153 @@
+#include "../utils/instance_generator.hpp"
+#include "../utils/binary_parser.hpp"
+#include "../utils/json_parser.hpp"
+
+#include <getopt.h>
+
+#include <iostream>
+
+// ./generator -n <points> -T <slices> --seed <seed> -o <problem.json|problem.bin> [параметры GeneratorParameters]
+int main(int argc, char *argv[]) {
+    GeneratorParameters params;
+    std::string output;
+
+    enum LongOption : int {
+        Seed = 256,
+        Clusters,
+        ClusterSpread,
+        Congestion,
+        CongestionAmplitude,
+        EdgeNoise,
+        Scores,
+        ScoreMin,
+        ScoreMax,
+        ServiceMin,
+        ServiceMax,
+        MinLoadRatio,
+        MaxLoadRatio,
+        TimeTightness,
+        DistanceTightness,
+    };
+    static const option long_options[] = {
+        {"points",               required_argument, nullptr, 'n'},
+        {"slices",               required_argument, nullptr, 'T'},
+        {"output",               required_argument, nullptr, 'o'},
+        {"seed",                 required_argument, nullptr, Seed},
+        {"clusters",             required_argument, nullptr, Clusters},
+        {"cluster-spread",       required_argument, nullptr, ClusterSpread},
+        {"congestion",           required_argument, nullptr, Congestion},
+        {"congestion-amplitude", required_argument, nullptr, CongestionAmplitude},
+        {"edge-noise",           required_argument, nullptr, EdgeNoise},
+        {"scores",               required_argument, nullptr, Scores},
+        {"score-min",            required_argument, nullptr, ScoreMin},
+        {"score-max",            required_argument, nullptr, ScoreMax},
+        {"service-min",          required_argument, nullptr, ServiceMin},
+        {"service-max",          required_argument, nullptr, ServiceMax},
+        {"min-load-ratio",       required_argument, nullptr, MinLoadRatio},
+        {"max-load-ratio",       required_argument, nullptr, MaxLoadRatio},
+        {"time-tightness",       required_argument, nullptr, TimeTightness},
+        {"distance-tightness",   required_argument, nullptr, DistanceTightness},
+        {nullptr,                0,                 nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:T:o:", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'n': {
+                params.points_count = std::stoul(optarg);
+                break;
+            }
+            case 'T': {
+                params.slices = std::stoul(optarg);
+                break;
+            }
+            case 'o': {
+                output = optarg;
+                break;
+            }
+            case Seed: {
+                params.seed = std::stoull(optarg);
+                break;
+            }
+            case Clusters: {
+                params.clusters = std::stoul(optarg);
+                break;
+            }
+            case ClusterSpread: {
+                params.cluster_spread = std::stod(optarg);
+                break;
+            }
+            case Congestion: {
+                if (!ParseCongestion(optarg, params.congestion)) {
+                    std::cerr << "Unknown congestion profile, expected flat, peaks or random" << std::endl;
+                    return -1;
+                }
+                break;
+            }
+            case CongestionAmplitude: {
+                params.congestion_amplitude = std::stod(optarg);
+                break;
+            }
+            case EdgeNoise: {
+                params.edge_noise = std::stod(optarg);
+                break;
+            }
+            case Scores: {
+                if (!ParseScoreDistribution(optarg, params.score_distribution)) {
+                    std::cerr << "Unknown score distribution, expected uniform, distance or skewed" << std::endl;
+                    return -1;
+                }
+                break;
+            }
+            case ScoreMin: {
+                params.score_min = std::stoll(optarg);
+                break;
+            }
+            case ScoreMax: {
+                params.score_max = std::stoll(optarg);
+                break;
+            }
+            case ServiceMin: {
+                params.service_min = std::stoll(optarg);
+                break;
+            }
+            case ServiceMax: {
+                params.service_max = std::stoll(optarg);
+                break;
+            }
+            case MinLoadRatio: {
+                params.min_load_ratio = std::stod(optarg);
+                break;
+            }
+            case MaxLoadRatio: {
+                params.max_load_ratio = std::stod(optarg);
+                break;
+            }
+            case TimeTightness: {
+                params.time_tightness = std::stod(optarg);
+                break;
+            }
+            case DistanceTightness: {
+                params.distance_tightness = std::stod(optarg);
+                break;
+            }
+            default: {
+                return -1;
+            }
+        }
+    }
+
+    if (output.empty() || params.points_count < 2 || params.slices == 0 ||
+        params.score_min > params.score_max || params.service_min > params.service_max) {
+        std::cerr << "Usage: generator -n <points >= 2> -T <slices >= 1> -o <problem.json|problem.bin> [options]"
+                  << std::endl;
+        return -1;
+    }
+
+    auto input = GenerateInstance(params);
+
+    bool written = BinaryParser::IsBinaryPath(output)
+                   ? BinaryParser::WriteInputDataToBinary(output, input)
+                   : JsonParser::WriteInputDataToJsonFile(output, input);
+    return written ? 0 : -2;
+}
@@ -0,0 +1,570 @@
+#include "../include/batch_evaluator.hpp"
+#include "../include/crossover.hpp"
+#include "../include/init_population.hpp"
+#include "../include/validation.hpp"
+#include "../include/vns.hpp"
+#include "../utils/binary_parser.hpp"
+#include "../utils/instance_generator.hpp"
+#include "../utils/json_parser.hpp"
+#include "../utils/random.hpp"
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+
+// Проверка решения:            ./validator -p <problem> -s <solution.json>
+// Дифференциальная проверка:   ./validator --differential [-p <problem> | -n <points> -T <slices>] [--seed <seed>]
+//                                          [--iterations <count>] [--operator <name>] [--reproducer <file.json>]
+// Повтор найденной ошибки:     ./validator --replay <file.json>
+namespace {
+    using json = nlohmann::json;
+
+    /// Операция поиска над одним или двумя родителями. Все случайные решения внутри
+    /// берутся из генераторов, инициализированных @seed, поэтому вызов повторяем.
+    struct Operator {
+        std::string name;
+        size_t parents;
+        std::function<Solution(const std::vector<Solution> &, const InputData &, uint64_t)> apply;
+    };
+
+    /// первое решение пачки, чьи метрики расходятся с Validation::Evaluate, иначе первое решение
+    Solution FirstMismatch(std::vector<Solution> &batch, const InputData &input) {
+        for (auto &solution: batch) {
+            auto expected = Validation::Evaluate(input, solution.tour);
+            Validation::Metrics actual{.distance = solution.distance, .time = solution.time, .score = solution.score};
+            if (actual != expected) {
+                return std::move(solution);
+            }
+        }
+        return std::move(batch.front());
+    }
+
+    std::vector<Operator> Operators() {
+        std::vector<Operator> operators;
+
+        auto neighbourhood = [](int level) {
+            return [level](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                SeedNeighbourhoods(seed);
+                return ApplyNeighbourhood(level, parents[0], input);
+            };
+        };
+        operators.push_back({"Shift", 1, neighbourhood(static_cast<int>(OptimizationType::Shift))});
+        operators.push_back({"SwapAdjacent", 1, neighbourhood(static_cast<int>(OptimizationType::SwapAdjacent))});
+        operators.push_back({"SwapAny", 1, neighbourhood(static_cast<int>(OptimizationType::SwapAny))});
+        operators.push_back({"TwoOpt", 1, neighbourhood(static_cast<int>(OptimizationType::TwoOpt))});
+        operators.push_back({"OrOpt", 1, neighbourhood(static_cast<int>(OptimizationType::OrOpt))});
+        // уровни больше OrOpt - OrOpt с сегментом длиннее на (level - OrOpt)
+        operators.push_back({"OrOpt/4", 1, neighbourhood(static_cast<int>(OptimizationType::OrOpt) + 1)});
+        operators.push_back({"OrOpt/5", 1, neighbourhood(static_cast<int>(OptimizationType::OrOpt) + 2)});
+
+        for (int level = 1; level <= 3; ++level) {
+            operators.push_back({"Perturbation/" + std::to_string(level), 1,
+                                 [level](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                     SeedNeighbourhoods(seed);
+                                     return Perturbation(parents[0], level, 0.1, input);
+                                 }});
+        }
+
+        operators.push_back({"Perturbation/batch", 1,
+                             [](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                 SeedNeighbourhoods(seed);
+                                 BatchEvaluator evaluator(input);
+                                 SetBatchEvaluator(&evaluator);
+                                 auto result = Perturbation(parents[0], 3, 0.1, input);
+                                 SetBatchEvaluator(nullptr);
+                                 return result;
+                             }});
+
+        // пакетная оценка перестановок родителя на каждом доступном наборе инструкций
+        for (auto backend: {BatchEvaluator::Backend::Scalar, BatchEvaluator::Backend::AVX2,
+                            BatchEvaluator::Backend::AVX512}) {
+            if (static_cast<int>(backend) > static_cast<int>(BatchEvaluator::Detect())) {
+                continue;
+            }
+            operators.push_back({std::string("eval/batch/") + BatchEvaluator::Name(backend), 1,
+                                 [backend](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                     Random::Generator rng(seed);
+                                     std::vector<Solution> batch(BatchEvaluator::max_lanes + 3, parents[0]);
+                                     for (auto &solution: batch) {
+                                         std::shuffle(solution.tour.begin() + 1, solution.tour.end() - 1, rng);
+                                     }
+                                     BatchEvaluator evaluator(input);
+                                     evaluator.set_backend(backend);
+                                     evaluator.evaluate(batch);
+                                     return FirstMismatch(batch, input);
+                                 }});
+        }
+
+        // оценка с досрочным выходом совпадает с полной, если маршрут в границах, и прерывается только
+        // на маршрутах вне границ; иначе возвращается маршрут с результатом, который не сойдется с проверкой
+        operators.push_back({"eval/early_abort", 1,
+                             [](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                 const auto points = static_cast<size_t>(input.points_count);
+                                 std::vector<int64_t> min_travel(points * points, std::numeric_limits<int64_t>::max());
+                                 for (const auto &slice: input.time_matrix) {
+                                     for (size_t from = 0; from < points; ++from) {
+                                         for (size_t to = 0; to < points; ++to) {
+                                             auto &minimum = min_travel[from * points + to];
+                                             minimum = std::min(minimum, slice[from][to]);
+                                         }
+                                     }
+                                 }
+
+                                 Random::Generator rng(seed);
+                                 auto solution = parents[0];
+                                 for (int attempt = 0; attempt < 16; ++attempt) {
+                                     std::shuffle(solution.tour.begin() + 1, solution.tour.end() - 1, rng);
+                                     const auto [distance, time, score] = input.get_path_time_distance_score(solution.tour);
+                                     const EvaluationLimits limits{.max_distance = input.max_distance,
+                                                                   .max_time = input.max_time,
+                                                                   .min_score = parents[0].score,
+                                                                   .min_travel = attempt % 2 ? min_travel.data() : nullptr};
+                                     const auto limited = input.get_path_time_distance_score(solution.tour, limits);
+                                     const bool inside = distance <= limits.max_distance && time <= limits.max_time &&
+                                                         score > limits.min_score;
+                                     if (limited.has_value() != inside ||
+                                         (limited && *limited != std::make_tuple(distance, time, score))) {
+                                         solution.distance = distance, solution.time = time, solution.score = score + 1;
+                                         return solution;
+                                     }
+                                     solution.distance = distance, solution.time = time, solution.score = score;
+                                 }
+                                 return solution;
+                             }});
+
+        operators.push_back({"VND", 1, [](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+            SeedNeighbourhoods(seed);
+            return VND(parents[0], 10, input);
+        }});
+        operators.push_back({"VNS", 1, [](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+            SeedNeighbourhoods(seed);
+            return VNS(parents[0], input, 3, 10, 0.1);
+        }});
+        operators.push_back({"VNS/adaptive", 1,
+                             [](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                 SeedNeighbourhoods(seed);
+                                 SetAdaptiveNeighbourhoods(true);
+                                 auto result = VNS(parents[0], input, 3, 10, 0.1);
+                                 SetAdaptiveNeighbourhoods(false);
+                                 return result;
+                             }});
+        // отсев ходов по нижней оценке не должен менять выбор хода
+        operators.push_back({"VND/move_bounds", 1,
+                             [](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                 SeedNeighbourhoods(seed);
+                                 SetMoveBounds(&input);
+                                 auto result = VND(parents[0], 10, input);
+                                 SetMoveBounds(nullptr);
+                                 return result;
+                             }});
+        operators.push_back({"VNS/tour_cache", 1,
+                             [](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                 SeedNeighbourhoods(seed);
+                                 SetTourCache(64);
+                                 auto result = VNS(parents[0], input, 3, 10, 0.1);
+                                 SetTourCache(0);
+                                 return result;
+                             }});
+
+        for (auto type: crossover_types) {
+            operators.push_back({std::string("crossover/") + SearchStatistics::crossover_names[static_cast<size_t>(type)], 2,
+                                 [type](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                     Crossover crossover(seed);
+                                     return crossover.crossover(type, parents[0], parents[1], input);
+                                 }});
+            operators.push_back({std::string("crossover/") + SearchStatistics::crossover_names[static_cast<size_t>(type)] +
+                                 "/batch", 2,
+                                 [type](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                     Crossover crossover(seed);
+                                     BatchEvaluator evaluator(input);
+                                     std::vector<std::pair<const Solution *, const Solution *>> pairs;
+                                     for (size_t i = 0; i < BatchEvaluator::max_lanes; ++i) {
+                                         pairs.emplace_back(&parents[i % 2], &parents[1 - i % 2]);
+                                     }
+                                     std::vector<Solution> children;
+                                     crossover.crossover_batch(type, pairs, input, evaluator, children);
+                                     return FirstMismatch(children, input);
+                                 }});
+        }
+
+        operators.push_back({"init/random_tour", 1,
+                             [](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                 PopulationInitializer initializer(seed);
+                                 Solution solution(0);
+                                 initializer.random_tour(solution, parents[0].tour.size(), input);
+                                 return solution;
+                             }});
+        operators.push_back({"init/grasp_tour", 1,
+                             [](const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+                                 PopulationInitializer initializer(seed);
+                                 Solution solution(0);
+                                 initializer.grasp_tour(solution, parents[0].tour.size(), 15, input);
+                                 return solution;
+                             }});
+
+        return operators;
+    }
+
+    Solution Evaluated(Path tour, const InputData &input) {
+        auto metrics = Validation::Evaluate(input, tour);
+        return Solution(std::move(tour), metrics.distance, metrics.time, metrics.score);
+    }
+
+    /// Описание расхождения результата операции с эталоном, пустая строка если расхождений нет
+    std::string Check(const Operator &op, const std::vector<Solution> &parents, const InputData &input, uint64_t seed) {
+        Solution result(0);
+        try {
+            result = op.apply(parents, input, seed);
+        } catch (const std::exception &e) {
+            return std::string("exception: ") + e.what();
+        }
+
+        if (auto error = Validation::CheckTour(input, result.tour); !error.empty()) {
+            return error;
+        }
+        if (auto error = Validation::CheckSameVertices(result.tour, parents[0].tour); !error.empty()) {
+            return error;
+        }
+
+        auto expected = Validation::Evaluate(input, result.tour);
+        Validation::Metrics actual{.distance = result.distance, .time = result.time, .score = result.score};
+        if (actual != expected) {
+            std::ostringstream message;
+            message << "metrics mismatch: operator reported " << actual << ", reference " << expected;
+            return message.str();
+        }
+        return {};
+    }
+
+    /// Подзадача без вершины @vertex и маршруты родителей в ее нумерации
+    void RemoveVertex(InputData &input, std::vector<Solution> &parents, Vertex vertex) {
+        std::vector<Vertex> points;
+        for (Vertex v = 0; v < input.points_count; ++v) {
+            if (v != vertex) {
+                points.push_back(v);
+            }
+        }
+        auto sub_input = input.restrict_to(points);
+
+        for (auto &parent: parents) {
+            Path tour;
+            for (auto v: parent.tour) {
+                if (v != vertex) {
+                    tour.push_back(v > vertex ? v - 1 : v);
+                }
+            }
+            parent = Evaluated(std::move(tour), sub_input);
+        }
+        input = std::move(sub_input);
+    }
+
+    /// Жадно удаляет вершины, пока ошибка воспроизводится
+    void Shrink(const Operator &op, InputData &input, std::vector<Solution> &parents, uint64_t seed) {
+        // меньше 4 вершин между депо операции окрестностей и кроссоверы не определены
+        constexpr size_t min_points = 5;
+
+        bool shrunk = true;
+        while (shrunk && input.points_count > min_points) {
+            shrunk = false;
+            for (Vertex vertex = input.points_count - 1; vertex > 0 && input.points_count > min_points; --vertex) {
+                auto candidate_input = input;
+                auto candidate_parents = parents;
+                RemoveVertex(candidate_input, candidate_parents, vertex);
+                if (!Check(op, candidate_parents, candidate_input, seed).empty()) {
+                    input = std::move(candidate_input);
+                    parents = std::move(candidate_parents);
+                    shrunk = true;
+                }
+            }
+        }
+    }
+
+    bool WriteReproducer(const std::string &path, const Operator &op, const InputData &input,
+                         const std::vector<Solution> &parents, uint64_t seed, const std::string &error) {
+        json tours = json::array();
+        for (const auto &parent: parents) {
+            tours.push_back(parent.tour);
+        }
+        json reproducer = {
+                {"operator", op.name},
+                {"seed",     seed},
+                {"error",    error},
+                {"tours",    tours},
+                {"instance", JsonParser::InputDataToJson(input)}
+        };
+
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Can`t open reproducer file " << path << std::endl;
+            return false;
+        }
+        file << reproducer.dump() << "\n";
+        return true;
+    }
+
+    const Operator *FindOperator(const std::vector<Operator> &operators, const std::string &name) {
+        for (const auto &op: operators) {
+            if (op.name == name) {
+                return &op;
+            }
+        }
+        std::cerr << "Unknown operator " << name << std::endl;
+        return nullptr;
+    }
+
+    int ValidateSolution(const InputData &input, const std::string &solution_path) {
+        OutData solution;
+        if (!JsonParser::ParseSolutionFromJson(solution_path, solution)) {
+            return 2;
+        }
+
+        int errors = 0;
+        auto report = [&errors](const std::string &error) {
+            if (!error.empty()) {
+                std::cout << "ERROR: " << error << std::endl;
+                ++errors;
+            }
+        };
+
+        report(Validation::CheckTour(input, solution.route));
+        if (errors > 0) {
+            return 1;
+        }
+
+        auto expected = Validation::Evaluate(input, solution.route);
+        Validation::Metrics reported{
+                .distance = solution.total_distance,
+                .time = solution.total_time,
+                .score = solution.total_value
+        };
+        std::cout << "reported:  " << reported << "\nrecomputed: " << expected << std::endl;
+
+        if (solution.solution_size != solution.route.size()) {
+            report("solution_size " + std::to_string(solution.solution_size) + " differs from route size " +
+                   std::to_string(solution.route.size()));
+        }
+        if (reported != expected) {
+            report("reported metrics differ from recomputed");
+        }
+        report(Validation::CheckConstraints(input, solution.route, expected));
+
+        std::cout << (errors == 0 ? "OK" : "FAILED") << std::endl;
+        return errors == 0 ? 0 : 1;
+    }
+
+    int RunDifferential(const InputData &instance, uint64_t seed, size_t iterations, const std::string &operator_name,
+                     const std::string &reproducer_path) {
+        auto operators = Operators();
+        if (!operator_name.empty()) {
+            auto op = FindOperator(operators, operator_name);
+            if (op == nullptr) {
+                return 2;
+            }
+            operators = {*op};
+        }
+
+        Random::SplitMix64 seeds(seed);
+        Random::Generator rng(seeds.next());
+        // подзадачи размером как у второго шага: от 5 точек до 60 или всех точек задачи
+        const size_t max_points = std::min<size_t>(instance.points_count - 1, 60);
+
+        for (size_t iteration = 0; iteration < iterations; ++iteration) {
+            const auto points_count = std::uniform_int_distribution<size_t>(std::min<size_t>(4, max_points), max_points)(rng);
+            std::vector<Vertex> candidates(instance.points_count - 1);
+            std::iota(candidates.begin(), candidates.end(), 1);
+            std::shuffle(candidates.begin(), candidates.end(), rng);
+
+            std::vector<Vertex> points{0};
+            points.insert(points.end(), candidates.begin(), candidates.begin() + points_count);
+            auto input = instance.restrict_to(points);
+
+            for (const auto &op: operators) {
+                const auto op_seed = seeds.next();
+
+                std::vector<Solution> parents;
+                for (size_t parent = 0; parent < op.parents; ++parent) {
+                    Path tour(points.size() + 1);
+                    std::iota(tour.begin(), tour.end() - 1, 0);
+                    tour.back() = 0;
+                    std::shuffle(tour.begin() + 1, tour.end() - 1, rng);
+                    parents.push_back(Evaluated(std::move(tour), input));
+                }
+
+                if (Check(op, parents, input, op_seed).empty()) {
+                    continue;
+                }
+
+                auto failing_input = input;
+                Shrink(op, failing_input, parents, op_seed);
+                auto error = Check(op, parents, failing_input, op_seed);
+
+                std::cout << "FAILED " << op.name << " on iteration " << iteration << " with seed " << op_seed
+                          << ": " << error << "\nminimal reproducer: " << failing_input.points_count << " points" << std::endl;
+                for (const auto &parent: parents) {
+                    std::cout << parent << std::endl;
+                }
+                if (WriteReproducer(reproducer_path, op, failing_input, parents, op_seed, error)) {
+                    std::cout << "written to " << reproducer_path << ", rerun with --replay" << std::endl;
+                }
+                return 1;
+            }
+        }
+
+        std::cout << "OK: " << iterations << " iterations of " << operators.size() << " operators" << std::endl;
+        return 0;
+    }
+
+    int RunReplay(const std::string &path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Can`t open reproducer file " << path << std::endl;
+            return 2;
+        }
+        json reproducer;
+        file >> reproducer;
+
+        auto operators = Operators();
+        auto op = FindOperator(operators, reproducer.at("operator").get<std::string>());
+        if (op == nullptr) {
+            return 2;
+        }
+
+        InputData input;
+        JsonParser::ParseInputData(reproducer.at("instance"), input);
+        std::vector<Solution> parents;
+        for (const auto &tour: reproducer.at("tours")) {
+            parents.push_back(Evaluated(tour.get<Path>(), input));
+        }
+
+        auto error = Check(*op, parents, input, reproducer.at("seed").get<uint64_t>());
+        std::cout << op->name << ": " << (error.empty() ? "OK" : error) << std::endl;
+        return error.empty() ? 0 : 1;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string problem_path;
+    std::string solution_path;
+    std::string replay_path;
+    std::string operator_name;
+    std::string reproducer_path = "validator_reproducer.json";
+    bool differential = false;
+    uint64_t seed = 1;
+    size_t iterations = 200;
+    GeneratorParameters generator;
+    generator.clusters = 3;
+
+    enum LongOption : int {
+        Differential = 256,
+        Seed,
+        Iterations,
+        OperatorName,
+        Reproducer,
+        Replay,
+    };
+    static const option long_options[] = {
+        {"problem",      required_argument, nullptr, 'p'},
+        {"solution",     required_argument, nullptr, 's'},
+        {"points",       required_argument, nullptr, 'n'},
+        {"slices",       required_argument, nullptr, 'T'},
+        {"differential", no_argument,       nullptr, Differential},
+        {"seed",         required_argument, nullptr, Seed},
+        {"iterations",   required_argument, nullptr, Iterations},
+        {"operator",     required_argument, nullptr, OperatorName},
+        {"reproducer",   required_argument, nullptr, Reproducer},
+        {"replay",       required_argument, nullptr, Replay},
+        {nullptr,        0,                 nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:s:n:T:", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'p': {
+                problem_path = optarg;
+                break;
+            }
+            case 's': {
+                solution_path = optarg;
+                break;
+            }
+            case 'n': {
+                generator.points_count = std::stoul(optarg);
+                break;
+            }
+            case 'T': {
+                generator.slices = std::stoul(optarg);
+                break;
+            }
+            case Differential: {
+                differential = true;
+                break;
+            }
+            case Seed: {
+                seed = std::stoull(optarg);
+                break;
+            }
+            case Iterations: {
+                iterations = std::stoul(optarg);
+                break;
+            }
+            case OperatorName: {
+                operator_name = optarg;
+                break;
+            }
+            case Reproducer: {
+                reproducer_path = optarg;
+                break;
+            }
+            case Replay: {
+                replay_path = optarg;
+                break;
+            }
+            default: {
+                return 2;
+            }
+        }
+    }
+
+    if (!replay_path.empty()) {
+        return RunReplay(replay_path);
+    }
+
+    InputData input;
+    if (!problem_path.empty()) {
+        bool parsed = BinaryParser::IsBinaryPath(problem_path)
+                      ? BinaryParser::ParseInputDataFromBinary(problem_path, input)
+                      : JsonParser::ParseInputDataFromJson(problem_path, input);
+        if (!parsed) {
+            return 2;
+        }
+    } else if (differential && generator.points_count >= 6 && generator.slices > 0) {
+        generator.seed = seed;
+        input = GenerateInstance(generator);
+    } else {
+        std::cerr << "Usage: validator -p <problem> -s <solution.json>\n"
+                     "       validator --differential [-p <problem> | -n <points >= 6> -T <slices>] [--seed <seed>]\n"
+                     "                 [--iterations <count>] [--operator <name>] [--reproducer <file.json>]\n"
+                     "       validator --replay <file.json>" << std::endl;
+        return 2;
+    }
+
+    if (differential) {
+        if (input.points_count < 6) {
+            std::cerr << "Differential mode needs at least 6 points" << std::endl;
+            return 2;
+        }
+        return RunDifferential(input, seed, iterations, operator_name, reproducer_path);
+    }
+
+    if (solution_path.empty()) {
+        std::cerr << "Solution path is required, use -s <solution.json>" << std::endl;
+        return 2;
+    }
+    return ValidateSolution(input, solution_path);
+}
@@ -0,0 +1,122 @@
+#include "binary_parser.hpp"
+
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+namespace {
+    constexpr std::array<char, 4> magic = {'T', 'D', 'P', 'D'};
+    constexpr uint32_t format_version = 1;
+
+    using BinaryParser::ReadValue;
+    using BinaryParser::WriteValue;
+
+    void WriteRow(std::ostream &out, const std::vector<int64_t> &row) {
+        for (auto value: row) {
+            WriteValue(out, value);
+        }
+    }
+
+    bool ReadRow(std::istream &in, std::vector<int64_t> &row, size_t size) {
+        row.resize(size);
+        for (auto &value: row) {
+            if (!ReadValue(in, value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+namespace BinaryParser {
+
+    bool IsBinaryPath(const std::string &path) {
+        constexpr std::string_view extension = ".bin";
+        return path.size() >= extension.size() &&
+               path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+    bool ParseInputData(std::istream &in, InputData &arg) {
+        std::array<char, 4> header{};
+        uint32_t version = 0;
+        if (!in.read(header.data(), header.size()) || header != magic ||
+            !ReadValue(in, version) || version != format_version) {
+            std::cerr << "Unknown binary problem format" << std::endl;
+            return false;
+        }
+
+        uint32_t slices = 0;
+        bool ok = ReadValue(in, arg.points_count) && ReadValue(in, arg.min_load) && ReadValue(in, arg.max_load) &&
+                  ReadValue(in, slices) && ReadValue(in, arg.max_time) && ReadValue(in, arg.max_distance);
+        // без склада и хотя бы одной точки или без срезов времени задачи нет
+        if (ok && (arg.points_count < 2 || slices == 0)) {
+            std::cerr << "Unknown binary problem format" << std::endl;
+            return false;
+        }
+
+        const size_t n = arg.points_count;
+        arg.distance_matrix.resize(n);
+        for (size_t i = 0; ok && i < n; ++i) {
+            ok = ReadRow(in, arg.distance_matrix[i], n);
+        }
+
+        // срезы добавляются по мере чтения, как строки в ReadRow: количество из заголовка еще не проверено,
+        // и поврежденный файл не должен заранее выделять под него память
+        arg.time_matrix.clear();
+        for (size_t t = 0; ok && t < slices; ++t) {
+            auto &slice = arg.time_matrix.emplace_back(n);
+            for (size_t i = 0; ok && i < n; ++i) {
+                ok = ReadRow(in, slice[i], n);
+            }
+        }
+
+        ok = ok && ReadRow(in, arg.point_scores, n - 1) && ReadRow(in, arg.point_service_times, n - 1);
+        if (!ok) {
+            std::cerr << "Binary problem file is truncated" << std::endl;
+        }
+        return ok;
+    }
+
+    bool ParseInputDataFromBinary(const std::string &path, InputData &arg) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Can`t open input file with problem" << std::endl;
+            return false;
+        }
+        return ParseInputData(file, arg);
+    }
+
+    bool WriteInputData(std::ostream &file, const InputData &arg) {
+        file.write(magic.data(), magic.size());
+        WriteValue(file, format_version);
+        WriteValue(file, arg.points_count);
+        WriteValue(file, arg.min_load);
+        WriteValue(file, arg.max_load);
+        WriteValue(file, static_cast<uint32_t>(arg.time_matrix.size()));
+        WriteValue(file, arg.max_time);
+        WriteValue(file, arg.max_distance);
+
+        for (const auto &row: arg.distance_matrix) {
+            WriteRow(file, row);
+        }
+        for (const auto &slice: arg.time_matrix) {
+            for (const auto &row: slice) {
+                WriteRow(file, row);
+            }
+        }
+        WriteRow(file, arg.point_scores);
+        WriteRow(file, arg.point_service_times);
+
+        return static_cast<bool>(file);
+    }
+
+    bool WriteInputDataToBinary(const std::string &path, const InputData &arg) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Can`t open output file to write problem" << std::endl;
+            return false;
+        }
+        return WriteInputData(file, arg);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "problem_arguments.hpp"
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+/// Бинарный формат задачи для больших инстансов, где json матриц занимает гигабайты.
+///
+/// Все числа little-endian:
+///  - магия "TDPD" и версия формата (uint32);
+///  - points_count, min_load, max_load (uint16), количество срезов (uint32);
+///  - max_time, max_distance (int64);
+///  - distance_matrix, затем срезы time_matrix построчно (int64);
+///  - point_scores, point_service_times (int64).
+namespace BinaryParser {
+    /// целое число little-endian, общее для всех бинарных форматов решателя
+    template <typename T>
+    void WriteValue(std::ostream &out, T value) {
+        using unsigned_type = std::make_unsigned_t<T>;
+        auto bits = static_cast<unsigned_type>(value);
+        char bytes[sizeof(T)];
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            bytes[i] = static_cast<char>((bits >> (8 * i)) & 0xff);
+        }
+        out.write(bytes, sizeof(T));
+    }
+
+    template <typename T>
+    bool ReadValue(std::istream &in, T &value) {
+        using unsigned_type = std::make_unsigned_t<T>;
+        unsigned char bytes[sizeof(T)];
+        if (!in.read(reinterpret_cast<char *>(bytes), sizeof(T))) {
+            return false;
+        }
+        unsigned_type bits = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            bits |= static_cast<unsigned_type>(bytes[i]) << (8 * i);
+        }
+        value = static_cast<T>(bits);
+        return true;
+    }
+
+    /// файлы с расширением .bin читаются как бинарные, остальные - как json
+    bool IsBinaryPath(const std::string &path);
+
+    bool ParseInputData(std::istream &in, InputData &arg);
+
+    bool ParseInputDataFromBinary(const std::string &path, InputData &arg);
+
+    bool WriteInputData(std::ostream &out, const InputData &arg);
+
+    bool WriteInputDataToBinary(const std::string &path, const InputData &arg);
+}
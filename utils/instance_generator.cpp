@@ -0,0 +1,246 @@
+#include "instance_generator.hpp"
+#include "random.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+    // SplitMix64 и распределения поверх него: в отличие от std::*_distribution
+    // результат не зависит от реализации стандартной библиотеки
+    class SplitMix64 : public Random::SplitMix64 {
+    public:
+        using Random::SplitMix64::SplitMix64;
+
+        // [0, 1)
+        double uniform() {
+            return static_cast<double>(next() >> 11) * 0x1.0p-53;
+        }
+
+        // [lo, hi]
+        int64_t uniform_int(int64_t lo, int64_t hi) {
+            return lo + static_cast<int64_t>(next() % static_cast<uint64_t>(hi - lo + 1));
+        }
+
+        // приближение стандартного нормального распределения суммой 12 равномерных (Ирвин-Холл)
+        double normal() {
+            double sum = 0;
+            for (int i = 0; i < 12; ++i) {
+                sum += uniform();
+            }
+            return sum - 6.0;
+        }
+    };
+
+    struct Point {
+        double x;
+        double y;
+    };
+
+    std::vector<Point> GeneratePoints(const GeneratorParameters &params, SplitMix64 &rng) {
+        const double size = params.area_size;
+        std::vector<Point> points(params.points_count);
+        // склад в центре области
+        points[0] = {size / 2, size / 2};
+
+        std::vector<Point> centers(params.clusters);
+        for (auto &center: centers) {
+            center = {size * (0.1 + 0.8 * rng.uniform()), size * (0.1 + 0.8 * rng.uniform())};
+        }
+
+        for (size_t i = 1; i < points.size(); ++i) {
+            if (centers.empty()) {
+                points[i] = {size * rng.uniform(), size * rng.uniform()};
+                continue;
+            }
+            const auto &center = centers[rng.uniform_int(0, centers.size() - 1)];
+            points[i] = {
+                std::clamp(center.x + params.cluster_spread * rng.normal(), 0.0, size),
+                std::clamp(center.y + params.cluster_spread * rng.normal(), 0.0, size)
+            };
+        }
+        return points;
+    }
+
+    // загруженность среза в [0, 1]
+    std::vector<double> CongestionProfile(const GeneratorParameters &params, SplitMix64 &rng) {
+        std::vector<double> profile(params.slices, 0.0);
+        const double slices = static_cast<double>(params.slices);
+
+        switch (params.congestion) {
+            case GeneratorParameters::Congestion::Flat: {
+                break;
+            }
+            case GeneratorParameters::Congestion::Peaks: {
+                const double width = std::max(1.0, slices / 8);
+                for (size_t t = 0; t < params.slices; ++t) {
+                    auto morning = 1.0 - std::abs(t - slices / 4) / width;
+                    auto evening = 1.0 - std::abs(t - 3 * slices / 4) / width;
+                    profile[t] = std::max({0.0, morning, evening});
+                }
+                break;
+            }
+            case GeneratorParameters::Congestion::Random: {
+                double level = rng.uniform();
+                for (auto &value: profile) {
+                    value = level;
+                    level = std::clamp(level + 0.4 * (rng.uniform() - 0.5), 0.0, 1.0);
+                }
+                break;
+            }
+        }
+        return profile;
+    }
+
+    // жадный маршрут по max_load ближайшим по времени точкам, по нему выставляются ограничения
+    std::pair<int64_t, int64_t> GreedyTourTimeDistance(const InputData &input) {
+        std::vector<bool> visited(input.points_count, false);
+        visited[0] = true;
+
+        int64_t time = 0, distance = 0;
+        InputData::points_type current = 0;
+        for (size_t step = 0; step < input.max_load; ++step) {
+            InputData::points_type next = 0;
+            int64_t best = std::numeric_limits<int64_t>::max();
+            for (InputData::points_type j = 1; j < input.points_count; ++j) {
+                if (!visited[j]) {
+                    auto cost = input.get_time_dependent_cost(time, current, j);
+                    if (cost < best) {
+                        best = cost, next = j;
+                    }
+                }
+            }
+            if (next == 0) {
+                break;
+            }
+            visited[next] = true;
+            time += best + input.point_service_times[next - 1];
+            distance += input.distance_matrix[current][next];
+            current = next;
+        }
+
+        time += input.get_time_dependent_cost(time, current, 0);
+        distance += input.distance_matrix[current][0];
+        return {time, distance};
+    }
+}
+
+InputData GenerateInstance(const GeneratorParameters &params) {
+    const size_t n = params.points_count;
+
+    // независимые потоки под каждую часть задачи: смена распределения скоров не двигает точки
+    SplitMix64 seeder(params.seed);
+    SplitMix64 points_rng(seeder.next());
+    SplitMix64 edges_rng(seeder.next());
+    SplitMix64 congestion_rng(seeder.next());
+    SplitMix64 scores_rng(seeder.next());
+
+    InputData input;
+    input.points_count = params.points_count;
+
+    const auto points = GeneratePoints(params, points_rng);
+    const auto profile = CongestionProfile(params, congestion_rng);
+    const double half_diagonal = params.area_size * std::sqrt(0.5);
+
+    input.distance_matrix.assign(n, std::vector<int64_t>(n, 0));
+    input.time_matrix.assign(params.slices, std::vector<std::vector<int64_t>>(n, std::vector<int64_t>(n, 0)));
+
+    // только sqrt: в отличие от hypot он везде корректно округлен, а значит детерминирован
+    auto euclidean = [&points](size_t i, size_t j) {
+        return std::sqrt((points[i].x - points[j].x) * (points[i].x - points[j].x) +
+                         (points[i].y - points[j].y) * (points[i].y - points[j].y));
+    };
+
+    std::vector<double> from_center(n);
+    for (size_t i = 0; i < n; ++i) {
+        from_center[i] = euclidean(i, 0);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            if (i == j) {
+                continue;
+            }
+            const auto distance = euclidean(i, j);
+            input.distance_matrix[i][j] = static_cast<int64_t>(distance);
+
+            const auto base_time = distance / params.speed * (1.0 + params.edge_noise * (2 * edges_rng.uniform() - 1));
+            // ребра у центра (склада) загружены сильнее окраин
+            const auto zone = 1.0 - 0.5 * std::min(1.0, (from_center[i] + from_center[j]) / (2 * half_diagonal));
+
+            for (size_t t = 0; t < params.slices; ++t) {
+                auto time = static_cast<int64_t>(base_time * (1.0 + params.congestion_amplitude * profile[t] * zone) + 0.5);
+                time = std::max<int64_t>(time, 1);
+                if (t > 0) {
+                    // FIFO: выехав позже, нельзя приехать раньше
+                    time = std::max(time, input.time_matrix[t - 1][i][j] - InputData::time_duration + 1);
+                }
+                input.time_matrix[t][i][j] = time;
+            }
+        }
+    }
+
+    const double max_from_center = *std::max_element(from_center.begin(), from_center.end());
+    input.point_scores.resize(n - 1);
+    input.point_service_times.resize(n - 1);
+    for (size_t i = 1; i < n; ++i) {
+        const double range = static_cast<double>(params.score_max - params.score_min);
+        double score = 0;
+        switch (params.score_distribution) {
+            case GeneratorParameters::ScoreDistribution::Uniform: {
+                score = static_cast<double>(scores_rng.uniform_int(params.score_min, params.score_max));
+                break;
+            }
+            case GeneratorParameters::ScoreDistribution::Distance: {
+                auto remoteness = max_from_center > 0 ? from_center[i] / max_from_center : 0.0;
+                score = params.score_min + range * std::min(1.0, remoteness * (0.75 + 0.5 * scores_rng.uniform()));
+                break;
+            }
+            case GeneratorParameters::ScoreDistribution::Skewed: {
+                auto u = scores_rng.uniform();
+                score = params.score_min + range * u * u * u;
+                break;
+            }
+        }
+        input.point_scores[i - 1] = static_cast<int64_t>(score);
+        input.point_service_times[i - 1] = scores_rng.uniform_int(params.service_min, params.service_max);
+    }
+
+    const double customers = static_cast<double>(n - 1);
+    input.max_load = static_cast<InputData::points_type>(
+            std::clamp<double>(std::round(params.max_load_ratio * customers), 1.0, customers));
+    input.min_load = static_cast<InputData::points_type>(
+            std::min<double>(std::floor(params.min_load_ratio * customers), input.max_load));
+
+    auto [greedy_time, greedy_distance] = GreedyTourTimeDistance(input);
+    input.max_time = static_cast<int64_t>(std::ceil(params.time_tightness * greedy_time));
+    input.max_distance = static_cast<int64_t>(std::ceil(params.distance_tightness * greedy_distance));
+
+    return input;
+}
+
+bool ParseCongestion(const std::string &name, GeneratorParameters::Congestion &congestion) {
+    if (name == "flat") {
+        congestion = GeneratorParameters::Congestion::Flat;
+    } else if (name == "peaks") {
+        congestion = GeneratorParameters::Congestion::Peaks;
+    } else if (name == "random") {
+        congestion = GeneratorParameters::Congestion::Random;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ParseScoreDistribution(const std::string &name, GeneratorParameters::ScoreDistribution &distribution) {
+    if (name == "uniform") {
+        distribution = GeneratorParameters::ScoreDistribution::Uniform;
+    } else if (name == "distance") {
+        distribution = GeneratorParameters::ScoreDistribution::Distance;
+    } else if (name == "skewed") {
+        distribution = GeneratorParameters::ScoreDistribution::Skewed;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "problem_arguments.hpp"
+
+#include <cstdint>
+#include <string>
+
+/// Параметры синтетической задачи TDTSP-PD.
+/// Генерация детерминирована: одинаковые параметры и @seed дают побитово одинаковую задачу
+/// на любой платформе (свои генератор и распределения, без std::*_distribution).
+struct GeneratorParameters {
+    enum class Congestion {
+        /// время перехода одинаково во всех срезах
+        Flat,
+        /// утренний и вечерний пики (на 1/4 и 3/4 горизонта срезов)
+        Peaks,
+        /// случайное блуждание загруженности от среза к срезу
+        Random,
+    };
+
+    enum class ScoreDistribution {
+        /// равномерно в [score_min, score_max]
+        Uniform,
+        /// растет с удаленностью от склада: дальние точки ценнее, но дороже по времени
+        Distance,
+        /// тяжелый хвост: большинство точек дешевые, редкие - очень ценные
+        Skewed,
+    };
+
+    uint64_t seed = 1;
+
+    /// количество точек, включая склад
+    InputData::points_type points_count = 100;
+    /// количество срезов time_matrix, срезы идут через InputData::time_duration
+    size_t slices = 24;
+
+    /// размер квадрата, в котором лежат точки
+    double area_size = 10000;
+    /// количество кластеров точек, 0 - равномерно по всей площади
+    size_t clusters = 0;
+    /// характерный радиус кластера
+    double cluster_spread = 800;
+
+    /// скорость в единицах расстояния за секунду для незагруженной дороги
+    double speed = 8;
+    Congestion congestion = Congestion::Peaks;
+    /// максимальное относительное замедление в пик, 0.5 - в полтора раза дольше
+    double congestion_amplitude = 0.5;
+    /// случайный разброс времени перехода по ребрам, доля от базового времени
+    double edge_noise = 0.1;
+
+    ScoreDistribution score_distribution = ScoreDistribution::Uniform;
+    int64_t score_min = 500;
+    int64_t score_max = 3000;
+    int64_t service_min = 60;
+    int64_t service_max = 600;
+
+    /// min_load и max_load как доля от количества точек без склада
+    double min_load_ratio = 0.0;
+    double max_load_ratio = 0.1;
+    /// max_time и max_distance как доля от жадного маршрута по max_load ближайшим точкам,
+    /// меньше 1 - ограничения жестче, чем у жадного маршрута
+    double time_tightness = 1.0;
+    double distance_tightness = 1.2;
+};
+
+InputData GenerateInstance(const GeneratorParameters &params);
+
+bool ParseCongestion(const std::string &name, GeneratorParameters::Congestion &congestion);
+
+bool ParseScoreDistribution(const std::string &name, GeneratorParameters::ScoreDistribution &distribution);
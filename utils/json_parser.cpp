@@ -1,3 +1,4 @@
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include "json_parser.hpp"
@@ -15,6 +16,20 @@ namespace nlohmann {
         j.at("point_service_times").get_to(t.point_service_times);
     }
 
+    inline void to_json(json &j, const InputData &t) {
+        j = json{
+                {"points_count",        t.points_count},
+                {"min_load",            t.min_load},
+                {"max_load",            t.max_load},
+                {"max_time",            t.max_time},
+                {"max_distance",        t.max_distance},
+                {"distance_matrix",     t.distance_matrix},
+                {"time_matrix",         t.time_matrix},
+                {"point_scores",        t.point_scores},
+                {"point_service_times", t.point_service_times}
+        };
+    }
+
     inline void to_json(json &j, const OutData &s) {
         j = json{
                 {"route",          s.route},
@@ -101,4 +116,207 @@ namespace JsonParser {
         file << j.dump(4);
         return true;
     };
-}
\ No newline at end of file
+
+    bool WriteSolutionTojsonFile(const std::string& jsonPath, Solution && solution, const nlohmann::json &extra) {
+        nlohmann::json j = std::move(solution);
+        j.update(extra);
+
+        std::ofstream file(jsonPath);
+        if (!file) {
+            std::cerr << "Can`t open output file to write solution" << std::endl;
+            return false;
+        }
+
+        file << j.dump(4);
+        return true;
+    }
+
+    bool ReplaceSolutionJsonFile(const std::string& jsonPath, const Solution &solution, const nlohmann::json &extra) {
+        nlohmann::json j = solution;
+        j.update(extra);
+
+        const auto temp_path = jsonPath + ".tmp";
+        {
+            std::ofstream file(temp_path);
+            if (!file) {
+                std::cerr << "Can`t open temporary file to write solution" << std::endl;
+                return false;
+            }
+            file << j.dump(4);
+            if (!file.flush()) {
+                std::cerr << "Can`t write solution to temporary file" << std::endl;
+                return false;
+            }
+        }
+
+        if (std::rename(temp_path.c_str(), jsonPath.c_str()) != 0) {
+            std::cerr << "Can`t replace solution file" << std::endl;
+            std::remove(temp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool WriteInputDataToJsonFile(const std::string &jsonPath, const InputData &input) {
+        std::ofstream file(jsonPath);
+        if (!file) {
+            std::cerr << "Can`t open output file to write problem" << std::endl;
+            return false;
+        }
+
+        file << json(input).dump();
+        return true;
+    }
+
+    void ParseInputData(const json &j, InputData &arg) {
+        arg = j.get<InputData>();
+    }
+
+    json InputDataToJson(const InputData &input) {
+        return input;
+    }
+
+    void ParseMetaParameters(const json &j, MetaParameters &meta) {
+        auto override_if_present = [&j](const char *name, auto &value) {
+            if (j.contains(name)) {
+                j.at(name).get_to(value);
+            }
+        };
+
+        override_if_present("population_size", meta.population_size);
+        override_if_present("alpha", meta.alpha);
+        override_if_present("beta", meta.beta);
+        override_if_present("nloop", meta.nloop);
+        override_if_present("kMax", meta.kMax);
+        override_if_present("p", meta.p);
+        override_if_present("max_iter_without_solution", meta.max_iter_without_solution);
+        override_if_present("max_crossover_candidates", meta.max_crossover_candidates);
+        override_if_present("adaptive_neighbourhoods", meta.adaptive_neighbourhoods);
+        override_if_present("init_threads", meta.init_threads);
+        override_if_present("tour_cache_size", meta.tour_cache_size);
+        override_if_present("batch_evaluation", meta.batch_evaluation);
+        override_if_present("move_bounds", meta.move_bounds);
+        override_if_present("racing_rung", meta.racing_rung);
+    }
+
+    json SolutionToJson(const Solution &solution) {
+        return solution;
+    }
+
+    json StatisticsToJson(const SolverStatistics &statistics) {
+        const auto &search = statistics.search;
+
+        json vnd = json::object();
+        for (size_t i = 0; i < search.vnd_applied.size(); ++i) {
+            const auto cpu_ms = static_cast<double>(search.neighbourhood_cpu_us[i]) / 1000.0;
+            vnd[SearchStatistics::neighbourhood_names[i]] = {
+                    {"applied",               search.vnd_applied[i]},
+                    {"accepted",              search.vnd_accepted[i]},
+                    {"perturbation_applied",  search.perturbation_applied[i]},
+                    {"perturbation_accepted", search.perturbation_accepted[i]},
+                    {"gain",                  search.neighbourhood_gain[i]},
+                    {"cpu_us",                search.neighbourhood_cpu_us[i]},
+                    {"gain_per_ms",           cpu_ms > 0 ? static_cast<double>(search.neighbourhood_gain[i]) / cpu_ms : 0.0}
+            };
+        }
+
+        json crossover = json::object();
+        for (size_t i = 0; i < search.crossover_applied.size(); ++i) {
+            crossover[SearchStatistics::crossover_names[i]] = {
+                    {"applied",  search.crossover_applied[i]},
+                    {"accepted", search.crossover_accepted[i]},
+                    {"cpu_us",   search.crossover_cpu_us[i]}
+            };
+        }
+
+        json threads = json::array();
+        for (const auto &thread: statistics.threads) {
+            threads.push_back({
+                    {"answer",                 thread.answer},
+                    {"score",                  thread.score},
+                    {"elapsed_us",             thread.elapsed_us},
+                    {"path_evaluations",       thread.path_evaluations},
+                    {"evaluations_per_second", thread.evaluations_per_second},
+                    {"rungs",                  thread.rungs},
+                    {"eliminated",             thread.eliminated},
+                    {"hopeless",               thread.hopeless}
+            });
+        }
+
+        return json{
+                {"seed",                        statistics.seed},
+                {"first_step_answers",          statistics.first_step_answers},
+                {"duplicate_answers",           statistics.duplicate_answers},
+                {"first_step_score",            statistics.first_step_score},
+                {"first_step_us",               statistics.first_step_us},
+                {"first_step_cost_evaluations", statistics.first_step_cost_evaluations},
+                {"second_step_us",              statistics.second_step_us},
+                {"warm_start",                  statistics.warm_start
+                                                ? json{{"score", statistics.warm_start_score},
+                                                       {"dropped", statistics.warm_start_dropped}}
+                                                : json(nullptr)},
+                {"phases_us",                   {
+                                                        {"population_init", search.population_init_us},
+                                                        {"initial_vns", search.initial_vns_us},
+                                                        {"ga_loop", search.ga_loop_us}
+                                                }},
+                {"path_evaluations",            search.path_evaluations},
+                {"cost_evaluations",            search.cost_evaluations},
+                {"ga_iterations",               search.ga_iterations},
+                {"dedup_rejections",            search.dedup_rejections},
+                {"tour_cache",                  {
+                                                        {"lookups", search.cache_lookups},
+                                                        {"hits", search.cache_hits},
+                                                        {"hit_rate", search.cache_lookups > 0
+                                                                     ? static_cast<double>(search.cache_hits) / search.cache_lookups
+                                                                     : 0.0},
+                                                        {"perturbation_skips", search.perturbation_skips}
+                                                }},
+                {"move_bounds",                 {
+                                                        {"checks", search.move_bound_checks},
+                                                        {"score_skips", search.move_bound_score_skips},
+                                                        {"distance_skips", search.move_bound_distance_skips},
+                                                        {"skip_rate", search.move_bound_checks > 0
+                                                                      ? static_cast<double>(search.move_bound_score_skips +
+                                                                                            search.move_bound_distance_skips) /
+                                                                        search.move_bound_checks
+                                                                      : 0.0}
+                                                }},
+                {"early_abort",                 {
+                                                        {"evaluations", search.limited_evaluations},
+                                                        {"aborts", search.early_aborts},
+                                                        {"abort_rate", search.limited_evaluations > 0
+                                                                       ? static_cast<double>(search.early_aborts) /
+                                                                         search.limited_evaluations
+                                                                       : 0.0}
+                                                }},
+                {"resume",                      {
+                                                        {"slice_updates", statistics.slice_updates},
+                                                        {"solutions", search.resumed_solutions},
+                                                        {"dropped", search.resume_dropped}
+                                                }},
+                {"checkpoint",                  {
+                                                        {"generation", statistics.checkpoint_generation},
+                                                        {"written", statistics.checkpoints_written}
+                                                }},
+                {"vnd",                         vnd},
+                {"crossover",                   crossover},
+                {"threads",                     threads}
+        };
+    }
+
+    json TraceToJson(const std::vector<IterInfo> &trace) {
+        json j = json::array();
+        for (const auto &info: trace) {
+            j.push_back({
+                    {"timestamp_us", info.timestamp_us},
+                    {"thread",       info.thread},
+                    {"phase",        IterInfo::phase_names[static_cast<size_t>(info.phase)]},
+                    {"score",        info.score},
+                    {"time",         info.time},
+                    {"distance",     info.distance}
+            });
+        }
+        return j;
+    }
+}
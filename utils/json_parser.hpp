@@ -2,6 +2,7 @@
 
 #include "problem_arguments.hpp"
 #include "../include/path.hpp"
+#include "../include/statistics.hpp"
 #include <nlohmann/json.hpp>
 
 namespace JsonParser {
@@ -12,4 +13,27 @@ namespace JsonParser {
     bool WriteSolutionToJsonFile(const std::string &jsonPath, OutData &&solution);
 
     bool WriteSolutionTojsonFile(const std::string& jsonPath, Solution && solution);
+
+    /// решение с дополнительными полями @extra (статистика, трасса сходимости)
+    bool WriteSolutionTojsonFile(const std::string& jsonPath, Solution && solution, const nlohmann::json &extra);
+
+    /// Решение с полями @extra пишется во временный файл рядом с @jsonPath и переименовывается в него,
+    /// поэтому читатель @jsonPath видит либо старое решение, либо новое целиком
+    bool ReplaceSolutionJsonFile(const std::string& jsonPath, const Solution &solution, const nlohmann::json &extra);
+
+    bool WriteInputDataToJsonFile(const std::string &jsonPath, const InputData &input);
+
+    /// разбор задачи из уже распарсенного json (например, из запроса демону)
+    void ParseInputData(const nlohmann::json &j, InputData &arg);
+
+    nlohmann::json InputDataToJson(const InputData &input);
+
+    /// переопределяет только те мета-параметры, которые есть в @j
+    void ParseMetaParameters(const nlohmann::json &j, MetaParameters &meta);
+
+    nlohmann::json SolutionToJson(const Solution &solution);
+
+    nlohmann::json StatisticsToJson(const SolverStatistics &statistics);
+
+    nlohmann::json TraceToJson(const std::vector<IterInfo> &trace);
 }
\ No newline at end of file
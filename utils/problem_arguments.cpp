@@ -1,6 +1,7 @@
 #include "problem_arguments.hpp"
-#include <unistd.h>
+#include <getopt.h>
 #include <ostream>
+#include <algorithm>
 
 #ifdef DEBUG
 #include "debug.h"
@@ -11,16 +12,58 @@ bool ParseProgramArguments(int argc, char *argv[], ProgramArguments &args) {
     args.save_csv = false;
     
     // Значения по умолчанию для мета-параметров
-    args.meta.population_size = 20;
-    args.meta.alpha = 15;
-    args.meta.beta = 0.2;
-    args.meta.nloop = 20;
-    args.meta.kMax = 10;
-    args.meta.p = 0.1;
-    args.meta.max_iter_without_solution = 15;
-    args.meta.max_crossover_candidates = 3;
+    args.meta = MetaParameters{};
     
-    while ((opt = getopt(argc, argv, "p:s:t:c:o:a:b:n:k:g:i:r:")) != -1) {
+    // короткие опции описывают параметры одиночного запуска, длинные - режимы работы
+    enum LongOption : int {
+        CacheSize = 256,
+        Stats,
+        Trace,
+        TraceFile,
+        TimelineFile,
+        Seed,
+        Adaptive,
+        InitThreads,
+        TourCacheSize,
+        BatchEval,
+        NoMoveBounds,
+        Racing,
+        Stream,
+        StopFile,
+        StopStdin,
+        WarmStartFile,
+        WarmStartNeighbours,
+        CheckpointFile,
+        CheckpointInterval,
+        Resume,
+    };
+    static const option long_options[] = {
+        {"daemon",       required_argument, nullptr, 'd'},
+        {"workers",      required_argument, nullptr, 'w'},
+        {"cache-size",   required_argument, nullptr, CacheSize},
+        {"stats",        no_argument,       nullptr, Stats},
+        {"trace",        no_argument,       nullptr, Trace},
+        {"trace-file",   required_argument, nullptr, TraceFile},
+        {"timeline",     required_argument, nullptr, TimelineFile},
+        {"seed",         required_argument, nullptr, Seed},
+        {"adaptive",     no_argument,       nullptr, Adaptive},
+        {"init-threads", required_argument, nullptr, InitThreads},
+        {"tour-cache",   required_argument, nullptr, TourCacheSize},
+        {"batch-eval",   no_argument,       nullptr, BatchEval},
+        {"no-move-bounds", no_argument,     nullptr, NoMoveBounds},
+        {"racing",       required_argument, nullptr, Racing},
+        {"stream",       required_argument, nullptr, Stream},
+        {"stop-file",    required_argument, nullptr, StopFile},
+        {"stop-stdin",   no_argument,       nullptr, StopStdin},
+        {"warm-start",   required_argument, nullptr, WarmStartFile},
+        {"warm-start-neighbours", required_argument, nullptr, WarmStartNeighbours},
+        {"checkpoint",   required_argument, nullptr, CheckpointFile},
+        {"checkpoint-interval", required_argument, nullptr, CheckpointInterval},
+        {"resume",       no_argument,       nullptr, Resume},
+        {nullptr,        0,                 nullptr, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "p:s:t:c:o:a:b:n:k:g:i:r:d:w:", long_options, nullptr)) != -1) {
         switch (opt) {
             case 'p': {
                 args.problemJsonPath = optarg;
@@ -71,6 +114,94 @@ bool ParseProgramArguments(int argc, char *argv[], ProgramArguments &args) {
                 args.meta.max_crossover_candidates = std::stoul(optarg);
                 break;
             }
+            case 'd': {
+                args.daemon_socket = optarg;
+                break;
+            }
+            case 'w': {
+                args.daemon_workers = std::max<size_t>(1, std::stoul(optarg));
+                break;
+            }
+            case CacheSize: {
+                args.daemon_cache_size = std::max<size_t>(1, std::stoul(optarg));
+                break;
+            }
+            case Stats: {
+                args.save_stats = true;
+                break;
+            }
+            case Trace: {
+                args.save_trace = true;
+                break;
+            }
+            case TraceFile: {
+                args.trace_file = optarg;
+                break;
+            }
+            case TimelineFile: {
+                args.timeline_file = optarg;
+                break;
+            }
+            case Seed: {
+                args.seed = std::stoull(optarg);
+                break;
+            }
+            case Adaptive: {
+                args.meta.adaptive_neighbourhoods = true;
+                break;
+            }
+            case InitThreads: {
+                args.meta.init_threads = std::max<size_t>(1, std::stoul(optarg));
+                break;
+            }
+            case TourCacheSize: {
+                args.meta.tour_cache_size = std::stoul(optarg);
+                break;
+            }
+            case BatchEval: {
+                args.meta.batch_evaluation = true;
+                break;
+            }
+            case NoMoveBounds: {
+                args.meta.move_bounds = false;
+                break;
+            }
+            case Racing: {
+                args.meta.racing_rung = std::stoul(optarg);
+                break;
+            }
+            case Stream: {
+                args.stream_target = optarg;
+                break;
+            }
+            case StopFile: {
+                args.stop_file = optarg;
+                break;
+            }
+            case StopStdin: {
+                args.stop_stdin = true;
+                break;
+            }
+            case WarmStartFile: {
+                args.warm_start_file = optarg;
+                break;
+            }
+            case WarmStartNeighbours: {
+                args.warm_start_neighbours = std::stoul(optarg);
+                break;
+            }
+            case CheckpointFile: {
+                args.checkpoint_file = optarg;
+                break;
+            }
+            case CheckpointInterval: {
+                args.checkpoint_interval = std::max<uint64_t>(1, std::stoull(optarg));
+                break;
+            }
+            case Resume: {
+                args.resume = true;
+                break;
+            }
             default: {
                 return false;
             }
@@ -89,25 +220,26 @@ int64_t InputData::get_time_dependent_cost(int64_t time,
                                            InputData::points_type from,
                                            InputData::points_type to) const {
 
-    if (is_mapped) {
-        from = from_new_to_old.at(from);
-        to = from_new_to_old.at(to);
-    }
-                                            
+    ++cost_evaluations;
+
     if (time >= time_duration * (time_matrix.size() - 1)) {
         return time_matrix[time_matrix.size() - 1][from][to];
     }
 
+    // линейная интерполяция в целых числах: (a * (D - r) + b * r) / D с отбрасыванием дробной части,
+    // без ошибок округления long double, поэтому ее можно повторить в пакетной оценке
     const auto time_matrix_idx = time / time_duration;
-    const long double alpha = static_cast<long double>(time - time_duration * time_matrix_idx) / time_duration;
+    const auto offset = time - time_duration * time_matrix_idx;
 
-    return static_cast<int64_t>((1 - alpha) * time_matrix[time_matrix_idx][from][to] +
-                                alpha * time_matrix[time_matrix_idx + 1][from][to]);
+    return (time_matrix[time_matrix_idx][from][to] * (time_duration - offset) +
+            time_matrix[time_matrix_idx + 1][from][to] * offset) / time_duration;
 }
 
 std::tuple<int64_t, int64_t, int64_t>
 InputData::get_path_time_distance_score(const std::vector<InputData::points_type> &path) const {
 
+    ++path_evaluations;
+
     if (path.size() <= 2) {
         return std::make_tuple(0, 0, 0);
     }
@@ -122,20 +254,12 @@ InputData::get_path_time_distance_score(const std::vector<InputData::points_type
     // 1 -> 2
     // ...
     // n -> 0
-    points_type from = 0, to = 0;
     for (size_t i = 0; i < path.size() - 1; ++i) {
-
-        if (is_mapped) {
-            from = from_new_to_old.at(path[i]);
-            to = from_new_to_old.at(path[i + 1]);
-        } else {
-            from = path[i];
-            to = path[i + 1];
-        }
+        const auto from = path[i];
+        const auto to = path[i + 1];
 
         distance += distance_matrix[from][to];
-        // функция сама сделает маппинг если is_mapped
-        auto travel_time = get_time_dependent_cost(time, path[i], path[i + 1]);
+        auto travel_time = get_time_dependent_cost(time, from, to);
         // auto travel_time = time_matrix[0][from][to];
         time += (to == 0 ? 0 : point_service_times[to - 1]) + travel_time;
         // point_scores - свдинуты на 1 индекс, т.к. 0 - депо
@@ -145,6 +269,99 @@ InputData::get_path_time_distance_score(const std::vector<InputData::points_type
     return std::make_tuple(distance, time, score);
 }
 
+std::optional<std::tuple<int64_t, int64_t, int64_t>>
+InputData::get_path_time_distance_score(const std::vector<InputData::points_type> &path,
+                                        const EvaluationLimits &limits) const {
+
+    ++path_evaluations;
+
+    if (path.size() <= 2) {
+        if (limits.min_score >= 0) {
+            return std::nullopt;
+        }
+        return std::make_tuple(0, 0, 0);
+    }
+
+    // расстояние не зависит от времени и считается сразу целиком, остаток маршрута оценивается
+    // оптимистично: важности и обслуживание еще не пройденных точек и нижние границы переходов
+    int64_t distance = 0;
+    int64_t remaining_scores = 0;
+    int64_t remaining_service = 0;
+    int64_t remaining_travel = 0;
+    for (size_t i = 0; i < path.size() - 1; ++i) {
+        const auto from = path[i];
+        const auto to = path[i + 1];
+        distance += distance_matrix[from][to];
+        if (to != 0) {
+            remaining_scores += point_scores[to - 1];
+            remaining_service += point_service_times[to - 1];
+        }
+        if (limits.min_travel != nullptr) {
+            remaining_travel += limits.min_travel[from * points_count + to];
+        }
+    }
+    if (distance > limits.max_distance) {
+        return std::nullopt;
+    }
+
+    int64_t time = 0;
+    int64_t score = 0;
+
+    for (size_t i = 0; i < path.size() - 1; ++i) {
+        const auto from = path[i];
+        const auto to = path[i + 1];
+
+        auto travel_time = get_time_dependent_cost(time, from, to);
+        const auto service_time = to == 0 ? 0 : point_service_times[to - 1];
+        const auto point_score = to == 0 ? 0 : point_scores[to - 1];
+        time += service_time + travel_time;
+        score += point_score - travel_time;
+        remaining_scores -= point_score;
+        remaining_service -= service_time;
+        if (limits.min_travel != nullptr) {
+            remaining_travel -= limits.min_travel[from * points_count + to];
+        }
+
+        if (time + remaining_service + remaining_travel > limits.max_time ||
+            score + remaining_scores - remaining_travel <= limits.min_score) {
+            return std::nullopt;
+        }
+    }
+
+    return std::make_tuple(distance, time, score);
+}
+
+InputData InputData::restrict_to(const std::vector<points_type> &points) const {
+    InputData sub;
+    sub.points_count = points.size();
+    sub.min_load = min_load;
+    sub.max_load = max_load;
+    sub.max_time = max_time;
+    sub.max_distance = max_distance;
+
+    const auto size = points.size();
+    sub.distance_matrix.assign(size, std::vector<int64_t>(size));
+    sub.time_matrix.assign(time_matrix.size(), std::vector<std::vector<int64_t>>(size, std::vector<int64_t>(size)));
+    for (size_t i = 0; i < size; ++i) {
+        for (size_t j = 0; j < size; ++j) {
+            sub.distance_matrix[i][j] = distance_matrix[points[i]][points[j]];
+            for (size_t t = 0; t < time_matrix.size(); ++t) {
+                sub.time_matrix[t][i][j] = time_matrix[t][points[i]][points[j]];
+            }
+        }
+    }
+
+    // скоры и времена обслуживания сдвинуты на 1, склад в них не входит
+    sub.point_scores.reserve(size - 1);
+    sub.point_service_times.reserve(size - 1);
+    for (size_t i = 1; i < size; ++i) {
+        sub.point_scores.push_back(point_scores[points[i] - 1]);
+        sub.point_service_times.push_back(point_service_times[points[i] - 1]);
+    }
+
+    return sub; // RVO
+}
+
 std::ostream &operator<<(std::ostream &os, const InputData &data) {
     os << "points_count: " << data.points_count << "\n";
     os << "min_load: " << data.min_load << "\n";
@@ -1,33 +1,93 @@
 #pragma once
 
 #include <cstdint>
+#include <limits>
 #include <vector>
 #include <string>
-#include <map>
+#include <optional>
+#include <tuple>
 
 struct MetaParameters {
-    int population_size;
-    int alpha;
-    double beta;
-    int nloop;
-    int kMax;
-    double p;
-    int max_iter_without_solution;
-    size_t max_crossover_candidates;
+    int population_size = 20;
+    int alpha = 15;
+    double beta = 0.2;
+    int nloop = 20;
+    int kMax = 10;
+    double p = 0.1;
+    int max_iter_without_solution = 15;
+    size_t max_crossover_candidates = 3;
+    /// адаптивный выбор окрестностей в VND и Perturbation вместо фиксированного порядка
+    bool adaptive_neighbourhoods = false;
+    /// потоки построения начальной популяции внутри одного потока решателя
+    size_t init_threads = 1;
+    /// записей в кэше оценок маршрутов каждого потока, 0 - без кэша
+    size_t tour_cache_size = 0;
+    /// оценивать маршруты начальной популяции и возмущения пачками в SIMD-лентах, см. BatchEvaluator
+    bool batch_evaluation = false;
+    /// отсекать ходы VND, которые по нижней оценке не улучшают решение, см. SetMoveBounds
+    bool move_bounds = true;
+    /// итераций GA до первой ступени отбора потоков последовательным делением пополам, 0 - без отбора
+    size_t racing_rung = 0;
 };
 
 
 struct ProgramArguments {
     std::string problemJsonPath;
     std::string solutionJsonPath;
-    uint64_t time;
+    /// секунд на второй шаг, в режиме демона - для запросов без поля "time"
+    uint64_t time = 10;
     std::string csv_file;
     bool save_csv;
+    /// писать подробную статистику поиска в json решения и в csv
+    bool save_stats = false;
+    /// seed генераторов случайных чисел, без него каждый запуск случаен
+    std::optional<uint64_t> seed;
+    /// писать трассу сходимости (каждое улучшение лучшего решения потока) в json решения
+    bool save_trace = false;
+    /// csv файл для трассы сходимости, если пустой - трасса пишется только в json
+    std::string trace_file;
+    /// файл для интервалов работы потоков в формате Chrome trace, если пустой - интервалы не пишутся
+    std::string timeline_file;
+    /// куда выдавать каждое новое лучшее решение: "-" - строками JSONL в stdout, иначе файл решения,
+    /// который заменяется атомарно; пустой - только итоговое решение
+    std::string stream_target;
+    /// остановить поиск с выдачей лучшего найденного, когда появится этот файл; пустой - не следить
+    std::string stop_file;
+    /// остановить поиск по строке "stop" в stdin
+    bool stop_stdin = false;
+    /// файл прошлого решения для теплого старта, пустой - поиск с нуля
+    std::string warm_start_file;
+    /// DP первого шага при теплом старте: nullopt - по всей задаче, 0 - без DP, иначе по окрестности
+    /// прошлого маршрута из стольких ближайших к каждой его вершине
+    std::optional<size_t> warm_start_neighbours;
+    /// файл чекпоинта второго шага, пустой - чекпоинты не пишутся
+    std::string checkpoint_file;
+    /// секунд между чекпоинтами
+    uint64_t checkpoint_interval = 60;
+    /// продолжить прерванный запуск с @checkpoint_file, если он уже есть
+    bool resume = false;
     MetaParameters meta;
+    /// путь до unix-сокета режима демона, "-" - читать запросы из stdin
+    std::string daemon_socket;
+    /// количество одновременно решаемых в режиме демона задач
+    size_t daemon_workers = 1;
+    /// максимальное количество задач, которые демон держит в кэше
+    size_t daemon_cache_size = 16;
 };
 
 bool ParseProgramArguments(int argc, char *argv[], ProgramArguments &args);
 
+/// Границы для оценки маршрута с досрочным выходом, по умолчанию без ограничений
+struct EvaluationLimits {
+    int64_t max_distance = std::numeric_limits<int64_t>::max();
+    int64_t max_time = std::numeric_limits<int64_t>::max();
+    /// маршрут нужен, только если его score строго больше
+    int64_t min_score = std::numeric_limits<int64_t>::min();
+    /// необязательная нижняя граница времени перехода по всем срезам, min_travel[from * points_count + to],
+    /// усиливает оптимистичную оценку остатка маршрута
+    const int64_t *min_travel = nullptr;
+};
+
 struct InputData {
     using points_type = uint16_t;
     /// количество точек в задаче, включая склад.
@@ -60,8 +120,21 @@ struct InputData {
 
     [[nodiscard]] std::tuple<int64_t, int64_t, int64_t> get_path_time_distance_score(const std::vector<points_type> &path) const;
 
-    std::map<points_type, points_type> from_new_to_old;
-    bool is_mapped = false;
+    /// Оценка @path с досрочным выходом: nullopt, как только маршрут заведомо выходит за расстояние
+    /// или время @limits или не дает score больше @limits.min_score. Остаток маршрута оценивается
+    /// оптимистично: важности оставшихся точек без времени переходов, их обслуживание без переходов.
+    /// Если маршрут в границах, результат совпадает с get_path_time_distance_score.
+    [[nodiscard]] std::optional<std::tuple<int64_t, int64_t, int64_t>>
+    get_path_time_distance_score(const std::vector<points_type> &path, const EvaluationLimits &limits) const;
+
+    /// количество вызовов get_path_time_distance_score и get_time_dependent_cost в текущем потоке,
+    /// для замеров производительности
+    static inline thread_local uint64_t path_evaluations = 0;
+    static inline thread_local uint64_t cost_evaluations = 0;
+
+    /// Подзадача только на точках @points, @points[0] должен быть складом.
+    /// Вершина i подзадачи соответствует вершине @points[i] исходной задачи.
+    [[nodiscard]] InputData restrict_to(const std::vector<points_type> &points) const;
 };
 
 std::ostream &operator<<(std::ostream &os, const InputData &data);